@@ -0,0 +1,144 @@
+#include "AssetPack.h"
+#include <cstring>
+#include <iostream>
+
+bool AssetPack::fail(const char* reason)
+{
+	std::cout << "ERROR::PACK::" << reason << " " << path << std::endl;
+	close();
+	return false;
+}
+
+bool AssetPack::open(const std::string &path)
+{
+	close();
+	this->path = path;
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::PACK::FILE_NOT_SUCCESFULLY_READ " << path << " : " << file.getError() << std::endl;
+		return false;
+	}
+	//The mapping starts on a page, every table is laid out on its own alignment by the packer
+	const char* base = file.data();
+	const std::size_t size = file.size();
+	if (size < sizeof(AssetPackHeader))
+		return fail("TRUNCATED_HEADER");
+	header = (const AssetPackHeader*)base;
+	if (std::memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0)
+		return fail("BAD_MAGIC");
+	if (header->version != ASSET_PACK_VERSION)
+		return fail("BAD_VERSION");
+	if (header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0 || header->slotCount < header->entryCount)
+		return fail("BAD_SLOT_COUNT");
+
+	const std::size_t entriesSize = (std::size_t)header->entryCount * sizeof(AssetPackEntry);
+	const std::size_t slotsSize = (std::size_t)header->slotCount * sizeof(std::uint32_t);
+	if (size < sizeof(AssetPackHeader) + entriesSize + slotsSize)
+		return fail("TRUNCATED_INDEX");
+	if (header->namesOffset > size || header->namesSize > size - header->namesOffset)
+		return fail("TRUNCATED_NAMES");
+	entries = (const AssetPackEntry*)(base + sizeof(AssetPackHeader));
+	slots = (const std::uint32_t*)(base + sizeof(AssetPackHeader) + entriesSize);
+	names = base + header->namesOffset;
+
+	//Checked once here so that the lookups never have to
+	for (std::uint32_t i = 0; i < header->entryCount; ++i)
+	{
+		const AssetPackEntry &entry = entries[i];
+		if (entry.offset > size || entry.size > size - entry.offset)
+			return fail("TRUNCATED_PAYLOAD");
+		if (entry.nameOffset >= header->namesSize || std::memchr(names + entry.nameOffset, '\0', header->namesSize - entry.nameOffset) == nullptr)
+			return fail("BAD_NAME");
+	}
+	for (std::uint32_t i = 0; i < header->slotCount; ++i)
+		if (slots[i] != ASSET_PACK_EMPTY_SLOT && slots[i] >= header->entryCount)
+			return fail("BAD_SLOT");
+	return true;
+}
+
+void AssetPack::close()
+{
+	file.close();
+	header = nullptr;
+	entries = nullptr;
+	slots = nullptr;
+	names = nullptr;
+}
+
+const AssetPackEntry* AssetPack::find(std::string_view name) const
+{
+	if (!header)
+		return nullptr;
+	//Open addressing, linear probing : the packer keeps half of the slots empty
+	const std::uint64_t hash = Shader::hashSource(name);
+	const std::uint32_t mask = header->slotCount - 1;
+	for (std::uint32_t slot = (std::uint32_t)hash & mask, probes = 0; probes < header->slotCount; slot = (slot + 1) & mask, ++probes)
+	{
+		const std::uint32_t index = slots[slot];
+		if (index == ASSET_PACK_EMPTY_SLOT)
+			return nullptr;
+		const AssetPackEntry &entry = entries[index];
+		//The name is only compared when the hashes match, so almost never for another asset
+		if (entry.nameHash == hash && name == names + entry.nameOffset)
+			return &entry;
+	}
+	return nullptr;
+}
+
+const AssetPackEntry* AssetPack::find(std::string_view name, AssetFormat format) const
+{
+	const AssetPackEntry* entry = find(name);
+	if (!entry)
+	{
+		std::cout << "ERROR::PACK::ASSET_NOT_FOUND " << name << std::endl;
+		return nullptr;
+	}
+	if (entry->format != (std::uint32_t)format)
+	{
+		std::cout << "ERROR::PACK::WRONG_FORMAT " << name << std::endl;
+		return nullptr;
+	}
+	return entry;
+}
+
+std::string_view AssetPack::getData(std::string_view name) const
+{
+	const AssetPackEntry* entry = find(name);
+	return entry ? getData(*entry) : std::string_view();
+}
+
+std::string_view AssetPack::getData(const AssetPackEntry &entry) const
+{
+	return std::string_view(file.data() + entry.offset, (std::size_t)entry.size);
+}
+
+const char* AssetPack::getName(const AssetPackEntry &entry) const
+{
+	return names + entry.nameOffset;
+}
+
+bool AssetPack::getTexture(std::string_view name, CookedTexture &texture) const
+{
+	const AssetPackEntry* entry = find(name, AssetFormat::CookedTexture);
+	if (!entry)
+		return false;
+	return texture.open((const unsigned char*)file.data() + entry->offset, (std::size_t)entry->size, getName(*entry));
+}
+
+bool AssetPack::getShader(std::string_view name, EmbeddedShader &shader) const
+{
+	const AssetPackEntry* entry = find(name, AssetFormat::Shader);
+	if (!entry)
+		return false;
+	shader.path = getName(*entry);
+	shader.code = getData(*entry);
+	shader.hash = entry->contentHash;
+	return true;
+}
+
+void AssetPack::addShaders(ShaderPreprocessor &preprocessor) const
+{
+	for (unsigned int i = 0; i < getEntryCount(); ++i)
+		if (entries[i].format == (std::uint32_t)AssetFormat::Shader)
+			preprocessor.addEmbedded(getName(entries[i]), getData(entries[i]), entries[i].contentHash);
+}
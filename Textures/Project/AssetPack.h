@@ -0,0 +1,98 @@
+#pragma once
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include "CookedTexture.h"
+#include "MappedFile.h"
+#include "Shader.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//Many assets in one file written by the TextureCooker tool (-pack), mapped once at startup :
+//	header | entries | hash slots | names | payloads
+//Finding an asset is a lookup in the hash slots, it costs no open / stat / read
+//The payloads are used in place : cooked textures are uploaded and shaders compiled straight from the mapping
+#define ASSET_PACK_MAGIC "APAK"
+#define ASSET_PACK_VERSION 1
+//Offset of every payload is a multiple of this (keeps the level alignment of the .ctex inside)
+#define ASSET_PACK_ALIGNMENT 64
+//Hash slot without entry
+#define ASSET_PACK_EMPTY_SLOT 0xFFFFFFFFu
+
+enum class AssetFormat : std::uint32_t
+{
+	//Bytes as they were on disk (.atlas table...)
+	Raw,
+	//.ctex file, see CookedTexture
+	CookedTexture,
+	//GLSL source
+	Shader
+};
+
+struct AssetPackHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t entryCount;
+	//Power of two, at least twice entryCount : the probes stay short
+	std::uint32_t slotCount;
+	//Block of the names, each one ends with a '\0'
+	std::uint64_t namesOffset;
+	std::uint64_t namesSize;
+};
+
+struct AssetPackEntry
+{
+	//Shader::hashSource of the name (path given to the packer, '/' separated)
+	std::uint64_t nameHash;
+	//Shader::hashSource of the payload : the key of the program binary cache for the shaders
+	std::uint64_t contentHash;
+	//From the start of the file
+	std::uint64_t offset;
+	std::uint64_t size;
+	std::uint32_t format;
+	//From namesOffset
+	std::uint32_t nameOffset;
+};
+
+//Read side, the whole file stays mapped while the pack is open
+class AssetPack
+{
+public:
+	//Map and check the file, on failure returns false and prints why
+	bool open(const std::string &path);
+	void close();
+	bool isOpen() const { return file.isOpen(); }
+
+	//nullptr when the pack holds no asset with that name
+	const AssetPackEntry* find(std::string_view name) const;
+	//Payload of the asset, empty when it is missing
+	std::string_view getData(std::string_view name) const;
+	std::string_view getData(const AssetPackEntry &entry) const;
+	const char* getName(const AssetPackEntry &entry) const;
+	unsigned int getEntryCount() const { return header ? header->entryCount : 0; }
+	const AssetPackEntry& getEntry(unsigned int index) const { return entries[index]; }
+
+	//The texture reads its levels from the mapping : the pack must stay open while it is used
+	bool getTexture(std::string_view name, CookedTexture &texture) const;
+	//Source usable by the Shader constructors, its hash was computed by the packer
+	bool getShader(std::string_view name, EmbeddedShader &shader) const;
+	//Serve every shader of the pack to the preprocessor so that their #include resolve inside the pack
+	void addShaders(ShaderPreprocessor &preprocessor) const;
+
+private:
+	MappedFile file;
+	std::string path;
+	//Point into the mapping
+	const AssetPackHeader* header = nullptr;
+	const AssetPackEntry* entries = nullptr;
+	const std::uint32_t* slots = nullptr;
+	const char* names = nullptr;
+
+	bool fail(const char* reason);
+	const AssetPackEntry* find(std::string_view name, AssetFormat format) const;
+};
+
+#endif
@@ -0,0 +1,549 @@
+#include "BlockCompressor.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//SSE2 is always there on x64, and on x86 when MSVC targets it (its default since VS2012)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//The 16 texels of a block, one array per channel (0-255) so that 4 texels fit in a SSE register
+	struct Block
+	{
+		alignas(16) float channel[4][16];
+	};
+
+	//Up to 16 colors the indices of a block choose from
+	struct Palette
+	{
+		float color[16][4];
+		int count;
+	};
+
+	const float colorWeights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	const float alphaWeights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float rgbaWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	//Closest palette entry of every texel, returns the summed squared error
+	//The SSE2 version adds in the same order : both choose the same indices
+	float fitIndices(const Block &block, const Palette &palette, const float* weights, unsigned char* indices)
+	{
+		float best[16];
+#ifdef BLOCK_SSE2
+		for (int group = 0; group < 16; group += 4)
+		{
+			__m128 texel[4];
+			for (int c = 0; c < 4; ++c)
+				texel[c] = _mm_load_ps(block.channel[c] + group);
+			__m128 bestError = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int p = 0; p < palette.count; ++p)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (int c = 0; c < 4; ++c)
+				{
+					const __m128 difference = _mm_sub_ps(texel[c], _mm_set1_ps(palette.color[p][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(_mm_set1_ps(weights[c]), _mm_mul_ps(difference, difference)));
+				}
+				const __m128 closer = _mm_cmplt_ps(error, bestError);
+				bestError = _mm_or_ps(_mm_and_ps(closer, error), _mm_andnot_ps(closer, bestError));
+				const __m128i closerIndex = _mm_castps_si128(closer);
+				bestIndex = _mm_or_si128(_mm_and_si128(closerIndex, _mm_set1_epi32(p)), _mm_andnot_si128(closerIndex, bestIndex));
+			}
+			alignas(16) int index[4];
+			_mm_storeu_ps(best + group, bestError);
+			_mm_store_si128((__m128i*)index, bestIndex);
+			for (int i = 0; i < 4; ++i)
+				indices[group + i] = (unsigned char)index[i];
+		}
+#else
+		for (int i = 0; i < 16; ++i)
+		{
+			best[i] = FLT_MAX;
+			indices[i] = 0;
+			for (int p = 0; p < palette.count; ++p)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 4; ++c)
+				{
+					const float difference = block.channel[c][i] - palette.color[p][c];
+					error += weights[c] * (difference * difference);
+				}
+				if (error < best[i])
+				{
+					best[i] = error;
+					indices[i] = (unsigned char)p;
+				}
+			}
+		}
+#endif
+		float total = 0.0f;
+		for (int i = 0; i < 16; ++i)
+			total += best[i];
+		return total;
+	}
+
+	//Line through the block that fits its texels best (weighted channels), as two endpoints
+	void principalEndpoints(const Block &block, const float* weights, float* start, float* end)
+	{
+		float mean[4] = {};
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int i = 0; i < 16; ++i)
+				mean[c] += block.channel[c][i];
+			mean[c] /= 16.0f;
+		}
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+			for (int a = 0; a < 4; ++a)
+				for (int b = 0; b < 4; ++b)
+					covariance[a][b] += weights[a] * weights[b] * (block.channel[a][i] - mean[a]) * (block.channel[b][i] - mean[b]);
+
+		//Power iteration, the largest eigenvector is the axis
+		float axis[4] = { weights[0], weights[1], weights[2], weights[3] };
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			for (int a = 0; a < 4; ++a)
+				for (int b = 0; b < 4; ++b)
+					next[a] += covariance[a][b] * axis[b];
+			const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f)
+				break;
+			for (int c = 0; c < 4; ++c)
+				axis[c] = next[c] / length;
+		}
+
+		float low = FLT_MAX, high = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 4; ++c)
+				t += (block.channel[c][i] - mean[c]) * axis[c] * weights[c];
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+		for (int c = 0; c < 4; ++c)
+		{
+			start[c] = std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f);
+			end[c] = std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f);
+		}
+	}
+
+	//Endpoints minimizing the squared error for fixed indices
+	//position[i] is where palette entry i sits between start (0) and end (1)
+	bool leastSquaresEndpoints(const Block &block, const unsigned char* indices, const float* position, float* start, float* end)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			const float b = position[indices[i]], a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 4; ++c)
+			{
+				ax[c] += a * block.channel[c][i];
+				bx[c] += b * block.channel[c][i];
+			}
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			return false;
+		for (int c = 0; c < 4; ++c)
+		{
+			start[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+			end[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	//---------- BC1 color ----------
+
+	unsigned int to565(const float* color)
+	{
+		const unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+		const unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+		const unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (r << 11) | (g << 5) | b;
+	}
+
+	void from565(unsigned int value, float* color)
+	{
+		const unsigned int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+		color[3] = 255.0f;
+	}
+
+	//Always the 4 colors mode (color0 > color1) : BC3 decodes its color block that way too
+	float fitColor(const Block &block, unsigned int color0, unsigned int color1, unsigned char* indices, unsigned int &first, unsigned int &second)
+	{
+		if (color0 < color1)
+			std::swap(color0, color1);
+		first = color0;
+		second = color1;
+		Palette palette;
+		from565(color0, palette.color[0]);
+		if (color0 == color1)
+		{
+			//Equal endpoints would mean the 3 colors mode, only index 0 is safe
+			palette.count = 1;
+			return fitIndices(block, palette, colorWeights, indices);
+		}
+		from565(color1, palette.color[1]);
+		for (int c = 0; c < 4; ++c)
+		{
+			palette.color[2][c] = (2.0f * palette.color[0][c] + palette.color[1][c]) / 3.0f;
+			palette.color[3][c] = (palette.color[0][c] + 2.0f * palette.color[1][c]) / 3.0f;
+		}
+		palette.count = 4;
+		return fitIndices(block, palette, colorWeights, indices);
+	}
+
+	void encodeColor(const Block &block, BlockPreset preset, unsigned char* out)
+	{
+		static const float position[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float start[4], end[4];
+		principalEndpoints(block, colorWeights, start, end);
+
+		unsigned char indices[16];
+		unsigned int color0, color1;
+		float error = fitColor(block, to565(end), to565(start), indices, color0, color1);
+		for (int iteration = 0; preset == BlockPreset::Quality && iteration < 2; ++iteration)
+		{
+			float refinedStart[4], refinedEnd[4];
+			if (!leastSquaresEndpoints(block, indices, position, refinedStart, refinedEnd))
+				break;
+			unsigned char refinedIndices[16];
+			unsigned int refined0, refined1;
+			const float refinedError = fitColor(block, to565(refinedStart), to565(refinedEnd), refinedIndices, refined0, refined1);
+			if (refinedError >= error)
+				break;
+			error = refinedError;
+			color0 = refined0;
+			color1 = refined1;
+			std::memcpy(indices, refinedIndices, 16);
+		}
+
+		std::uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (std::uint32_t)indices[i] << (i * 2);
+		out[0] = (unsigned char)(color0 & 0xFF);
+		out[1] = (unsigned char)(color0 >> 8);
+		out[2] = (unsigned char)(color1 & 0xFF);
+		out[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = (unsigned char)(bits >> (i * 8));
+	}
+
+	//---------- BC3 alpha ----------
+
+	float fitAlpha(const Block &block, int alpha0, int alpha1, unsigned char* indices)
+	{
+		Palette palette = {};
+		palette.count = 8;
+		float* value[8];
+		for (int p = 0; p < 8; ++p)
+			value[p] = &palette.color[p][3];
+		*value[0] = (float)alpha0;
+		*value[1] = (float)alpha1;
+		if (alpha0 > alpha1)
+		{
+			//6 interpolated values
+			for (int p = 1; p < 7; ++p)
+				*value[p + 1] = (float)((7 - p) * alpha0 + p * alpha1) / 7.0f;
+		}
+		else
+		{
+			//4 interpolated values, then 0 and 255
+			for (int p = 1; p < 5; ++p)
+				*value[p + 1] = (float)((5 - p) * alpha0 + p * alpha1) / 5.0f;
+			*value[6] = 0.0f;
+			*value[7] = 255.0f;
+		}
+		return fitIndices(block, palette, alphaWeights, indices);
+	}
+
+	void encodeAlpha(const Block &block, BlockPreset preset, unsigned char* out)
+	{
+		int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			const int alpha = (int)block.channel[3][i];
+			low = std::min(low, alpha);
+			high = std::max(high, alpha);
+			//0 and 255 are free in the 6 values mode
+			if (alpha > 0 && alpha < 255)
+			{
+				innerLow = std::min(innerLow, alpha);
+				innerHigh = std::max(innerHigh, alpha);
+			}
+		}
+
+		unsigned char indices[16];
+		int alpha0 = high, alpha1 = low;
+		float error = fitAlpha(block, alpha0, alpha1, indices);
+		if (preset == BlockPreset::Quality && innerLow <= innerHigh)
+		{
+			unsigned char otherIndices[16];
+			const float otherError = fitAlpha(block, innerLow, innerHigh, otherIndices);
+			if (otherError < error)
+			{
+				error = otherError;
+				alpha0 = innerLow;
+				alpha1 = innerHigh;
+				std::memcpy(indices, otherIndices, 16);
+			}
+		}
+
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (std::uint64_t)indices[i] << (i * 3);
+		out[0] = (unsigned char)alpha0;
+		out[1] = (unsigned char)alpha1;
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (unsigned char)(bits >> (i * 8));
+	}
+
+	//---------- BC7 mode 6 ----------
+
+	const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	const float bc7Positions[16] = { 0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+		34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f };
+
+	//7 bits per channel, the p-bit is the shared lowest bit of the 4 channels
+	struct Mode6Endpoint
+	{
+		int value[4];
+		int pbit;
+	};
+
+	Mode6Endpoint quantizeMode6(const float* color, int pbit)
+	{
+		Mode6Endpoint endpoint;
+		endpoint.pbit = pbit;
+		for (int c = 0; c < 4; ++c)
+			endpoint.value[c] = std::min(std::max((int)std::floor((color[c] - pbit) / 2.0f + 0.5f), 0), 127);
+		return endpoint;
+	}
+
+	float quantizationError(const float* color, const Mode6Endpoint &endpoint)
+	{
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			const float difference = color[c] - (float)((endpoint.value[c] << 1) | endpoint.pbit);
+			error += difference * difference;
+		}
+		return error;
+	}
+
+	float fitMode6(const Block &block, const Mode6Endpoint &first, const Mode6Endpoint &second, unsigned char* indices)
+	{
+		Palette palette;
+		palette.count = 16;
+		for (int p = 0; p < 16; ++p)
+			for (int c = 0; c < 4; ++c)
+			{
+				const int e0 = (first.value[c] << 1) | first.pbit;
+				const int e1 = (second.value[c] << 1) | second.pbit;
+				palette.color[p][c] = (float)(((64 - bc7Weights[p]) * e0 + bc7Weights[p] * e1 + 32) >> 6);
+			}
+		return fitIndices(block, palette, rgbaWeights, indices);
+	}
+
+	//Best p-bits for a pair of endpoints : Fast picks them per endpoint, Quality tries the 4 pairs
+	float encodeMode6Endpoints(const Block &block, const float* start, const float* end, BlockPreset preset, Mode6Endpoint &first, Mode6Endpoint &second, unsigned char* indices)
+	{
+		if (preset == BlockPreset::Fast)
+		{
+			const Mode6Endpoint start0 = quantizeMode6(start, 0), start1 = quantizeMode6(start, 1);
+			const Mode6Endpoint end0 = quantizeMode6(end, 0), end1 = quantizeMode6(end, 1);
+			first = quantizationError(start, start0) <= quantizationError(start, start1) ? start0 : start1;
+			second = quantizationError(end, end0) <= quantizationError(end, end1) ? end0 : end1;
+			return fitMode6(block, first, second, indices);
+		}
+		float best = FLT_MAX;
+		for (int pbits = 0; pbits < 4; ++pbits)
+		{
+			const Mode6Endpoint a = quantizeMode6(start, pbits & 1), b = quantizeMode6(end, pbits >> 1);
+			unsigned char candidate[16];
+			const float error = fitMode6(block, a, b, candidate);
+			if (error < best)
+			{
+				best = error;
+				first = a;
+				second = b;
+				std::memcpy(indices, candidate, 16);
+			}
+		}
+		return best;
+	}
+
+	//Little endian bit stream of one 128 bits block
+	struct BitWriter
+	{
+		unsigned char* out;
+		int position = 0;
+
+		void write(std::uint32_t value, int count)
+		{
+			for (int i = 0; i < count; ++i, ++position)
+				if (value & (1u << i))
+					out[position >> 3] |= (unsigned char)(1 << (position & 7));
+		}
+	};
+
+	void encodeBC7(const Block &block, BlockPreset preset, unsigned char* out)
+	{
+		float start[4], end[4];
+		principalEndpoints(block, rgbaWeights, start, end);
+		Mode6Endpoint first, second;
+		unsigned char indices[16];
+		float error = encodeMode6Endpoints(block, start, end, preset, first, second, indices);
+		for (int iteration = 0; preset == BlockPreset::Quality && iteration < 2; ++iteration)
+		{
+			float refinedStart[4], refinedEnd[4];
+			if (!leastSquaresEndpoints(block, indices, bc7Positions, refinedStart, refinedEnd))
+				break;
+			Mode6Endpoint refinedFirst, refinedSecond;
+			unsigned char refinedIndices[16];
+			const float refinedError = encodeMode6Endpoints(block, refinedStart, refinedEnd, preset, refinedFirst, refinedSecond, refinedIndices);
+			if (refinedError >= error)
+				break;
+			error = refinedError;
+			first = refinedFirst;
+			second = refinedSecond;
+			std::memcpy(indices, refinedIndices, 16);
+		}
+
+		//The top bit of the first index is implicit (0) : swap the endpoints when it would be 1
+		if (indices[0] & 8)
+		{
+			std::swap(first, second);
+			for (int i = 0; i < 16; ++i)
+				indices[i] = (unsigned char)(15 - indices[i]);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer{ out };
+		//Mode 6 : six 0 bits then a 1
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.write(first.value[c], 7);
+			writer.write(second.value[c], 7);
+		}
+		writer.write(first.pbit, 1);
+		writer.write(second.pbit, 1);
+		writer.write(indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.write(indices[i], 4);
+	}
+
+	//---------- Images ----------
+
+	void loadBlock(const unsigned char* pixels, int width, int height, int channels, int blockX, int blockY, Block &block)
+	{
+		for (int y = 0; y < 4; ++y)
+			for (int x = 0; x < 4; ++x)
+			{
+				const int sourceX = std::min(blockX * 4 + x, width - 1);
+				const int sourceY = std::min(blockY * 4 + y, height - 1);
+				const unsigned char* texel = pixels + ((std::size_t)sourceY * width + sourceX) * channels;
+				const int i = y * 4 + x;
+				if (channels < 3)
+				{
+					block.channel[0][i] = block.channel[1][i] = block.channel[2][i] = texel[0];
+					block.channel[3][i] = channels == 2 ? texel[1] : 255.0f;
+				}
+				else
+				{
+					block.channel[0][i] = texel[0];
+					block.channel[1][i] = texel[1];
+					block.channel[2][i] = texel[2];
+					block.channel[3][i] = channels == 4 ? texel[3] : 255.0f;
+				}
+			}
+	}
+
+	void compressRows(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockPreset preset, int firstRow, int lastRow, unsigned char* out)
+	{
+		const int blocksX = (width + 3) / 4;
+		const std::size_t size = blockSize(format);
+		Block block;
+		for (int blockY = firstRow; blockY < lastRow; ++blockY)
+			for (int blockX = 0; blockX < blocksX; ++blockX)
+			{
+				loadBlock(pixels, width, height, channels, blockX, blockY, block);
+				unsigned char* destination = out + ((std::size_t)blockY * blocksX + blockX) * size;
+				switch (format)
+				{
+				case BlockFormat::BC1:
+					encodeColor(block, preset, destination);
+					break;
+				case BlockFormat::BC3:
+					encodeAlpha(block, preset, destination);
+					encodeColor(block, preset, destination + 8);
+					break;
+				case BlockFormat::BC7:
+					encodeBC7(block, preset, destination);
+					break;
+				}
+			}
+	}
+}
+
+GLenum blockFormatGL(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+std::size_t blockSize(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+std::size_t compressedSize(BlockFormat format, int width, int height)
+{
+	return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+std::vector<unsigned char> compressBlocks(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockPreset preset, ThreadPool* pool)
+{
+	std::vector<unsigned char> blocks(compressedSize(format, width, height));
+	if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+		return std::vector<unsigned char>();
+
+	const int blocksY = (height + 3) / 4;
+	if (!pool)
+	{
+		compressRows(pixels, width, height, channels, format, preset, 0, blocksY, blocks.data());
+		return blocks;
+	}
+	//A few jobs per worker so that a slow part of the image does not keep the others waiting
+	const int jobCount = std::min(blocksY, (int)pool->getWorkerCount() * 4);
+	unsigned char* out = blocks.data();
+	for (int job = 0; job < jobCount; ++job)
+	{
+		const int firstRow = blocksY * job / jobCount, lastRow = blocksY * (job + 1) / jobCount;
+		pool->submit([=] { compressRows(pixels, width, height, channels, format, preset, firstRow, lastRow, out); });
+	}
+	pool->wait();
+	return blocks;
+}
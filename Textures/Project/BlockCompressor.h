@@ -0,0 +1,54 @@
+#pragma once
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+//S3TC and BPTC are extensions for the 3.3 core headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+//Block compression of 8 bits images, every 4x4 texels become one block the GPU samples directly
+//	- BC1 : RGB, 8 bytes per block (6:1 against RGB8)
+//	- BC3 : RGBA, BC1 color + interpolated alpha, 16 bytes per block (4:1 against RGBA8)
+//	- BC7 : RGBA, 16 bytes per block, best quality (only mode 6 is written : one subset, 7.7.7.7 endpoints)
+//The blocks are shared out between the workers of a ThreadPool, the palette fitting runs with SSE2
+enum class BlockFormat
+{
+	BC1,
+	BC3,
+	BC7
+};
+
+enum class BlockPreset
+{
+	//Endpoints from the principal axis of the block only
+	Fast,
+	//Endpoints refined by least squares, every mode and p-bit tried
+	Quality
+};
+
+//Internal format given to glCompressedTexImage2D / glTexStorage2D
+GLenum blockFormatGL(BlockFormat format);
+//Bytes per 4x4 block
+std::size_t blockSize(BlockFormat format);
+//Bytes of a compressed image : the sides are rounded up to whole blocks
+std::size_t compressedSize(BlockFormat format, int width, int height);
+
+//Compress a tightly packed image of 1 to 4 channels (grey, grey alpha, RGB, RGBA, missing alpha reads as 255)
+//The blocks past the right / bottom edge repeat the last column / row
+//With a pool, rows of blocks are compressed in parallel : never call it from a job of that same pool
+std::vector<unsigned char> compressBlocks(const unsigned char* pixels, int width, int height, int channels, BlockFormat format, BlockPreset preset, ThreadPool* pool = nullptr);
+
+#endif
@@ -0,0 +1,106 @@
+#include "CookedMesh.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+	bool isUpToDate(const std::string &input, const std::string &output)
+	{
+		std::error_code error;
+		const auto outputTime = std::filesystem::last_write_time(output, error);
+		if (error)
+			return false;
+		const auto inputTime = std::filesystem::last_write_time(input, error);
+		return !error && outputTime >= inputTime;
+	}
+}
+
+bool CookedMesh::fail(const std::string &path, const char* reason)
+{
+	error = reason;
+	std::cout << "ERROR::MESH::COOKED::" << reason << " " << path << std::endl;
+	close();
+	return false;
+}
+
+void CookedMesh::close()
+{
+	file.close();
+	data = nullptr;
+	header = {};
+}
+
+bool CookedMesh::open(const std::string &path)
+{
+	close();
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::MESH::FILE_NOT_SUCCESFULLY_READ " << path << " : " << file.getError() << std::endl;
+		error = file.getError();
+		return false;
+	}
+	data = (const unsigned char*)file.data();
+	const std::size_t size = file.size();
+	if (size < sizeof(CookedMeshHeader))
+		return fail(path, "TRUNCATED_HEADER");
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, COOKED_MESH_MAGIC, 4) != 0)
+		return fail(path, "BAD_MAGIC");
+	if (header.version != COOKED_MESH_VERSION)
+		return fail(path, "BAD_VERSION");
+	if (header.vertexSize != sizeof(MeshVertex))
+		return fail(path, "BAD_VERTEX_SIZE");
+	if (header.vertexCount == 0 || header.indexCount == 0 || header.indexCount % 3 != 0)
+		return fail(path, "BAD_SIZE");
+	//Divided rather than multiplied, a corrupt count can't wrap around
+	if (header.vertexOffset > size || header.vertexCount > (size - header.vertexOffset) / sizeof(MeshVertex))
+		return fail(path, "TRUNCATED_VERTICES");
+	if (header.indexOffset > size || header.indexCount > (size - header.indexOffset) / sizeof(std::uint32_t))
+		return fail(path, "TRUNCATED_INDICES");
+	if (header.vertexOffset % COOKED_MESH_ALIGNMENT != 0 || header.indexOffset % COOKED_MESH_ALIGNMENT != 0)
+		return fail(path, "BAD_ALIGNMENT");
+	//upload() copies the indices as they are : one past the vertices would make the GPU read past the VBO
+	const std::uint32_t* indices = (const std::uint32_t*)getIndexData();
+	std::uint32_t largest = 0;
+	for (std::size_t i = 0; i < getIndexCount(); ++i)
+		largest = std::max(largest, indices[i]);
+	if (largest >= header.vertexCount)
+		return fail(path, "BAD_INDEX");
+	error.clear();
+	return true;
+}
+
+bool CookedMesh::load(const std::string &source, ThreadPool* pool)
+{
+	const std::string path = cachePathOf(source);
+	//A cache of another version is cooked again rather than refused
+	if (isUpToDate(source, path) && open(path))
+		return true;
+	if (!cookMesh(source, path, pool))
+	{
+		error = "COOK_FAILED";
+		return false;
+	}
+	return open(path);
+}
+
+void CookedMesh::upload(unsigned int vao, unsigned int vbo, unsigned int ebo) const
+{
+	MeshFormat::apply(vao, vbo, ebo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(getVertexCount() * sizeof(MeshVertex)), getVertexData(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(getIndexCount() * sizeof(std::uint32_t)), getIndexData(), GL_STATIC_DRAW);
+}
+
+std::string CookedMesh::cachePathOf(const std::string &source)
+{
+	return std::filesystem::path(source).replace_extension(".cmesh").string();
+}
+
+bool CookedMesh::isCookedPath(const std::string &path)
+{
+	const char extension[] = ".cmesh";
+	const std::size_t length = sizeof(extension) - 1;
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
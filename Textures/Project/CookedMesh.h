@@ -0,0 +1,82 @@
+#pragma once
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include "MappedFile.h"
+#include "MeshImporter.h"
+#include "VertexLayout.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Mesh cache written after an import (.cmesh) :
+//	header | vertices | indices
+//The vertices are MeshVertex as they go in the VBO and the indices 32 bits as they go in the EBO,
+//already in the order of the MeshOptimizer passes
+#define COOKED_MESH_MAGIC "CMSH"
+#define COOKED_MESH_VERSION 1
+//Offset of the vertices and of the indices in the file is a multiple of this
+#define COOKED_MESH_ALIGNMENT 16
+
+struct CookedMeshHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	//sizeof(MeshVertex) when it was written
+	std::uint32_t vertexSize;
+	std::uint32_t padding;
+	std::uint64_t vertexCount;
+	std::uint64_t indexCount;
+	//From the start of the file
+	std::uint64_t vertexOffset;
+	std::uint64_t indexOffset;
+	//Box around every position
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+//Attributes of a MeshVertex buffer : 0 position, 1 normal, 2 texCoord
+typedef VertexFormat<MeshVertex,
+	VERTEX_ATTRIBUTE(MeshVertex, 0, position),
+	VERTEX_ATTRIBUTE(MeshVertex, 1, normal),
+	VERTEX_ATTRIBUTE(MeshVertex, 2, texCoord)> MeshFormat;
+
+//Read side : the file is mapped and the buffers are filled from the mapping, nothing is parsed
+class CookedMesh
+{
+public:
+	//Map and check the file, every index included, on failure returns false and getError() tells why
+	bool open(const std::string &path);
+	//Opens the cache of a .obj / .glb, importing and cooking it first when the cache is missing
+	//or older than the source
+	bool load(const std::string &source, ThreadPool* pool = nullptr);
+	//The buffers keep their own copy once uploaded, the mapping can go
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	const std::string& getError() const { return error; }
+
+	const CookedMeshHeader& getHeader() const { return header; }
+	std::size_t getVertexCount() const { return (std::size_t)header.vertexCount; }
+	std::size_t getIndexCount() const { return (std::size_t)header.indexCount; }
+	const unsigned char* getVertexData() const { return data + header.vertexOffset; }
+	const unsigned char* getIndexData() const { return data + header.indexOffset; }
+
+	//MeshFormat::apply on vao then glBufferData of vbo and ebo straight from the mapping
+	//Draw with glDrawElements(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, 0)
+	void upload(unsigned int vao, unsigned int vbo, unsigned int ebo) const;
+
+	//model.obj -> model.cmesh, next to the source
+	static std::string cachePathOf(const std::string &source);
+	//True for the paths cachePathOf gives
+	static bool isCookedPath(const std::string &path);
+
+private:
+	MappedFile file;
+	const unsigned char* data = nullptr;
+	CookedMeshHeader header = {};
+	std::string error;
+
+	bool fail(const std::string &path, const char* reason);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "CookedTexture.h"
+#include "GLExtensions.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	bool hasTextureStorage()
+	{
+		return hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_storage");
+	}
+}
+
+bool CookedTexture::fail(const std::string &path, const char* reason)
+{
+	error = reason;
+	std::cout << "ERROR::TEXTURE::COOKED::" << reason << " " << path << std::endl;
+	file.close();
+	data = nullptr;
+	dataSize = 0;
+	levels.clear();
+	header = {};
+	return false;
+}
+
+bool CookedTexture::open(const std::string &path)
+{
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::TEXTURE::FILE_NOT_SUCCESFULLY_READ " << path << " : " << file.getError() << std::endl;
+		error = file.getError();
+		return false;
+	}
+	return open((const unsigned char*)file.data(), file.size(), path);
+}
+
+bool CookedTexture::open(const unsigned char* data, std::size_t size, const std::string &path)
+{
+	//A texture reopened from memory drops the file it had mapped
+	if (data != (const unsigned char*)file.data())
+		file.close();
+	this->data = data;
+	dataSize = size;
+	if (dataSize < sizeof(CookedTextureHeader))
+		return fail(path, "TRUNCATED_HEADER");
+	//Copied out of the mapping, nothing guarantees its alignment
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, COOKED_TEXTURE_MAGIC, 4) != 0)
+		return fail(path, "BAD_MAGIC");
+	if (header.version != COOKED_TEXTURE_VERSION)
+		return fail(path, "BAD_VERSION");
+	if (header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > 32)
+		return fail(path, "BAD_SIZE");
+
+	const std::size_t indexSize = header.levelCount * sizeof(CookedTextureLevel);
+	if (dataSize < sizeof(header) + indexSize)
+		return fail(path, "TRUNCATED_INDEX");
+	levels.resize(header.levelCount);
+	std::memcpy(levels.data(), data + sizeof(header), indexSize);
+
+	for (unsigned int level = 0; level < header.levelCount; ++level)
+	{
+		const CookedTextureLevel &entry = levels[level];
+		const std::size_t expected = cookedLevelSize(header.internalFormat, getLevelWidth(level), getLevelHeight(level));
+		if (expected == 0)
+			return fail(path, "UNSUPPORTED_FORMAT");
+		if (entry.size != expected)
+			return fail(path, "BAD_LEVEL_SIZE");
+		if (entry.offset > dataSize || entry.size > dataSize - entry.offset)
+			return fail(path, "TRUNCATED_LEVEL");
+	}
+	error.clear();
+	return true;
+}
+
+int CookedTexture::getLevelWidth(unsigned int level) const
+{
+	return std::max(1, (int)(header.width >> level));
+}
+
+int CookedTexture::getLevelHeight(unsigned int level) const
+{
+	return std::max(1, (int)(header.height >> level));
+}
+
+const unsigned char* CookedTexture::getLevelData(unsigned int level) const
+{
+	return data + levels[level].offset;
+}
+
+std::size_t CookedTexture::getLevelSize(unsigned int level) const
+{
+	return (std::size_t)levels[level].size;
+}
+
+std::size_t CookedTexture::getDataSize() const
+{
+	std::size_t size = 0;
+	for (const CookedTextureLevel &entry : levels)
+		size += (std::size_t)entry.size;
+	return size;
+}
+
+bool CookedTexture::isSupported() const
+{
+	switch (header.internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return hasGLExtension("GL_EXT_texture_compression_s3tc");
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+	default:
+		return true;
+	}
+}
+
+void CookedTexture::allocate() const
+{
+	const GLsizei levelCount = (GLsizei)header.levelCount;
+	//One call for the whole chain, the driver knows the final size of the texture up front
+	if (hasTextureStorage())
+		glTexStorage2D(GL_TEXTURE_2D, levelCount, header.internalFormat, header.width, header.height);
+	//Sampling never goes past the levels that were cooked
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	//Without a mipmap filter only level 0 would ever be read
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+}
+
+void CookedTexture::uploadLevel(unsigned int level, const void* pixels) const
+{
+	const GLsizei width = getLevelWidth(level), height = getLevelHeight(level);
+	const bool storage = hasTextureStorage();
+	if (isCompressed())
+	{
+		const GLsizei size = (GLsizei)getLevelSize(level);
+		if (storage)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, header.internalFormat, size, pixels);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, header.internalFormat, width, height, 0, size, pixels);
+	}
+	else
+	{
+		if (storage)
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, header.format, header.type, pixels);
+		else
+			glTexImage2D(GL_TEXTURE_2D, level, header.internalFormat, width, height, 0, header.format, header.type, pixels);
+	}
+}
+
+void CookedTexture::upload() const
+{
+	//Levels are tightly packed
+	GLint previousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	allocate();
+	for (unsigned int level = 0; level < header.levelCount; ++level)
+		uploadLevel(level, getLevelData(level));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+}
+
+bool CookedTexture::isCookedPath(const std::string &path)
+{
+	const char extension[] = ".ctex";
+	const std::size_t length = sizeof(extension) - 1;
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
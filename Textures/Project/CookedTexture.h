@@ -0,0 +1,113 @@
+#pragma once
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include <glad/glad.h>
+#include "BlockCompressor.h"
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Texture container written by the TextureCooker tool (.ctex), laid out like a KTX2 file :
+//	header | level index | level data
+//Every mip level is already stored in its final internal format, tightly packed (rows are not padded)
+//or as 4x4 blocks for the compressed formats (BC1, BC3, BC7)
+//Level 0 is the full size image, each next level halves the size down to 1x1
+#define COOKED_TEXTURE_MAGIC "CTEX"
+#define COOKED_TEXTURE_VERSION 1
+//Offset of every level in the file is a multiple of this
+#define COOKED_TEXTURE_ALIGNMENT 16
+
+struct CookedTextureHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	//Sized format given to glTexStorage2D (GL_RGBA8...)
+	std::uint32_t internalFormat;
+	//Format and type of the stored pixels (GL_RGBA, GL_UNSIGNED_BYTE...), both 0 for a compressed format
+	std::uint32_t format;
+	std::uint32_t type;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t levelCount;
+};
+
+//One entry per mip level, right after the header
+struct CookedTextureLevel
+{
+	//From the start of the file
+	std::uint64_t offset;
+	std::uint64_t size;
+};
+
+//Bytes taken by one level of the given size, 0 when the internal format is not supported
+//Inline so that the cooker can use it without linking GL
+inline std::size_t cookedLevelSize(std::uint32_t internalFormat, std::uint32_t width, std::uint32_t height)
+{
+	std::size_t texelSize = 0;
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM: return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+	case GL_R8: texelSize = 1; break;
+	case GL_RG8: texelSize = 2; break;
+	case GL_RGB8: case GL_SRGB8: texelSize = 3; break;
+	case GL_RGBA8: case GL_SRGB8_ALPHA8: texelSize = 4; break;
+	default: return 0;
+	}
+	return (std::size_t)width * height * texelSize;
+}
+
+//Read side : the file is mapped and the levels are uploaded from the mapping, nothing is decoded
+class CookedTexture
+{
+public:
+	//Map and check the file, on failure returns false and getError() tells why
+	bool open(const std::string &path);
+	//Same from a .ctex already in memory (asset pack...), nothing is copied : data must outlive the texture
+	//name is only used by the error messages
+	bool open(const unsigned char* data, std::size_t size, const std::string &name);
+	bool isOpen() const { return data != nullptr; }
+	const std::string& getError() const { return error; }
+
+	const CookedTextureHeader& getHeader() const { return header; }
+	unsigned int getLevelCount() const { return header.levelCount; }
+	int getLevelWidth(unsigned int level) const;
+	int getLevelHeight(unsigned int level) const;
+	const unsigned char* getLevelData(unsigned int level) const;
+	std::size_t getLevelSize(unsigned int level) const;
+	//Bytes of all the levels together
+	std::size_t getDataSize() const;
+	bool isCompressed() const { return header.format == 0; }
+	//False when the context cannot sample the internal format (S3TC / BPTC extensions missing)
+	bool isSupported() const;
+
+	//Storage of the texture bound to GL_TEXTURE_2D, immutable with GL 4.2 / ARB_texture_storage
+	//Without it the levels are only made by uploadLevel()
+	//Also sets the level range and a mipmap min filter when there are several levels
+	void allocate() const;
+	//Upload one level, glTex(Sub)Image2D or glCompressedTex(Sub)Image2D for the block formats
+	//pixels is an offset when a pixel unpack buffer is bound
+	void uploadLevel(unsigned int level, const void* pixels) const;
+	//allocate() then every level straight from the mapping
+	void upload() const;
+
+	//True for the paths the TextureCooker writes
+	static bool isCookedPath(const std::string &path);
+
+private:
+	//Only opened when the texture is read from its own file
+	MappedFile file;
+	const unsigned char* data = nullptr;
+	std::size_t dataSize = 0;
+	CookedTextureHeader header = {};
+	std::vector<CookedTextureLevel> levels;
+	std::string error;
+
+	bool fail(const std::string &path, const char* reason);
+};
+
+#endif
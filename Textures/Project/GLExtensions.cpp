@@ -0,0 +1,48 @@
+#include "GLExtensions.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const std::vector<std::string>& extensions()
+	{
+		//Sorted once so that every query is a binary search
+		static std::vector<std::string> names;
+		static bool loaded = false;
+		if (!loaded)
+		{
+			loaded = true;
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; ++i)
+			{
+				const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+				if (name)
+					names.push_back(name);
+			}
+			std::sort(names.begin(), names.end());
+		}
+		return names;
+	}
+}
+
+bool hasGLVersion(int major, int minor)
+{
+	static GLint contextMajor = -1, contextMinor = -1;
+	if (contextMajor < 0)
+	{
+		glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+		glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	}
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool hasGLExtension(std::string_view name)
+{
+	const std::vector<std::string> &names = extensions();
+	auto it = std::lower_bound(names.begin(), names.end(), name,
+		[](const std::string &a, std::string_view b) { return std::string_view(a) < b; });
+	return it != names.end() && *it == name;
+}
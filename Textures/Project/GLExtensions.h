@@ -0,0 +1,12 @@
+#pragma once
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <string_view>
+
+//Capabilities of the current context, read from the driver once and then cached
+//(the samples only ever use one context)
+bool hasGLVersion(int major, int minor);
+bool hasGLExtension(std::string_view name);
+
+#endif
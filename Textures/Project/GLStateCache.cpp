@@ -0,0 +1,184 @@
+#include "GLStateCache.h"
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+}
+
+GLStateCache& GLStateCache::get()
+{
+	static GLStateCache cache;
+	return cache;
+}
+
+int GLStateCache::textureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	case GL_TEXTURE_3D: return 3;
+	case GL_TEXTURE_1D: return 4;
+	default: return -1;
+	}
+}
+
+unsigned int* GLStateCache::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return &arrayBuffer;
+	case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+	case GL_PIXEL_UNPACK_BUFFER: return &pixelUnpackBuffer;
+	default: return nullptr;
+	}
+}
+
+void GLStateCache::useProgram(unsigned int id)
+{
+	if (program == id)
+	{
+		++frame.skipped;
+		return;
+	}
+	glUseProgram(id);
+	program = id;
+	++frame.issued;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao)
+{
+	if (vertexArray == vao)
+	{
+		++frame.skipped;
+		return;
+	}
+	glBindVertexArray(vao);
+	vertexArray = vao;
+	elementBuffer = UNKNOWN;
+	++frame.issued;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+	unsigned int* slot = bufferSlot(target);
+	if (slot && *slot == buffer)
+	{
+		++frame.skipped;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (slot)
+		*slot = buffer;
+	++frame.issued;
+}
+
+void GLStateCache::activeTexture(unsigned int textureUnit)
+{
+	if (unit == textureUnit)
+	{
+		++frame.skipped;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	unit = textureUnit;
+	++frame.issued;
+}
+
+void GLStateCache::bindTexture(unsigned int textureUnit, GLenum target, unsigned int texture)
+{
+	const int targetIndex = textureTargetIndex(target);
+	if (targetIndex < 0 || textureUnit >= MAX_UNITS)
+	{
+		activeTexture(textureUnit);
+		glBindTexture(target, texture);
+		++frame.issued;
+		return;
+	}
+
+	unsigned int &bound = textures[textureUnit][targetIndex];
+	if (bound == texture)
+	{
+		//The glActiveTexture that would have come with it is saved too
+		frame.skipped += unit == textureUnit ? 1 : 2;
+		return;
+	}
+	activeTexture(textureUnit);
+	glBindTexture(target, texture);
+	bound = texture;
+	++frame.issued;
+}
+
+void GLStateCache::forgetProgram(unsigned int id)
+{
+	if (program == id)
+		program = UNKNOWN;
+}
+
+void GLStateCache::forgetVertexArray(unsigned int vao)
+{
+	if (vertexArray == vao)
+	{
+		vertexArray = UNKNOWN;
+		elementBuffer = UNKNOWN;
+	}
+}
+
+void GLStateCache::forgetBuffer(unsigned int buffer)
+{
+	if (arrayBuffer == buffer)
+		arrayBuffer = UNKNOWN;
+	if (elementBuffer == buffer)
+		elementBuffer = UNKNOWN;
+	if (pixelUnpackBuffer == buffer)
+		pixelUnpackBuffer = UNKNOWN;
+}
+
+void GLStateCache::forgetTexture(unsigned int texture)
+{
+	for (unsigned int i = 0; i < MAX_UNITS; ++i)
+	{
+		for (unsigned int target = 0; target < TEXTURE_TARGETS; ++target)
+		{
+			if (textures[i][target] == texture)
+				textures[i][target] = UNKNOWN;
+		}
+	}
+}
+
+void GLStateCache::invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	arrayBuffer = UNKNOWN;
+	elementBuffer = UNKNOWN;
+	pixelUnpackBuffer = UNKNOWN;
+	unit = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_UNITS; ++i)
+	{
+		for (unsigned int target = 0; target < TEXTURE_TARGETS; ++target)
+			textures[i][target] = UNKNOWN;
+	}
+}
+
+GLStateCache::Stats GLStateCache::endFrame()
+{
+	frame.frames = 1;
+	total.frames += frame.frames;
+	total.issued += frame.issued;
+	total.skipped += frame.skipped;
+	lastFrame = frame;
+	frame = Stats();
+	return lastFrame;
+}
+
+const GLStateCache::Stats& GLStateCache::getLastFrame() const
+{
+	return lastFrame;
+}
+
+const GLStateCache::Stats& GLStateCache::getTotal() const
+{
+	return total;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+//CPU mirror of the bindings that change the most (program, VAO, buffers, textures per unit)
+//A bind to the object already bound is dropped before it reaches the driver
+//Every bind of these targets must go through the cache, after a raw GL bind call invalidate()
+class GLStateCache
+{
+public:
+	struct Stats
+	{
+		unsigned int frames = 0;
+		//Calls sent to the driver / calls dropped because nothing would change
+		unsigned int issued = 0;
+		unsigned int skipped = 0;
+	};
+
+	//Cache of the current context (the samples only have one)
+	static GLStateCache& get();
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	//GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_PIXEL_UNPACK_BUFFER are cached, other targets are forwarded
+	void bindBuffer(GLenum target, unsigned int buffer);
+	void activeTexture(unsigned int unit);
+	//Binds texture on unit (0 for GL_TEXTURE0), only switches the active unit if the bind is needed
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+	//To call before/after deleting an object : GL unbinds deleted objects itself
+	void forgetProgram(unsigned int program);
+	void forgetVertexArray(unsigned int vao);
+	void forgetBuffer(unsigned int buffer);
+	void forgetTexture(unsigned int texture);
+	//Forget everything, the next bind of each kind is always issued
+	void invalidate();
+
+	//Call once per frame : returns the counters of the frame that just ended and resets them
+	Stats endFrame();
+	const Stats& getLastFrame() const;
+	//Every frame ended since the start
+	const Stats& getTotal() const;
+
+private:
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+	static const unsigned int MAX_UNITS = 32;
+	static const unsigned int TEXTURE_TARGETS = 5;
+
+	unsigned int program = UNKNOWN;
+	unsigned int vertexArray = UNKNOWN;
+	unsigned int arrayBuffer = UNKNOWN;
+	//The element buffer binding is part of the VAO -> unknown again after each VAO change
+	unsigned int elementBuffer = UNKNOWN;
+	unsigned int pixelUnpackBuffer = UNKNOWN;
+	unsigned int unit = UNKNOWN;
+	unsigned int textures[MAX_UNITS][TEXTURE_TARGETS];
+
+	Stats frame;
+	Stats lastFrame;
+	Stats total;
+
+	GLStateCache();
+	static int textureTargetIndex(GLenum target);
+	unsigned int* bufferSlot(GLenum target);
+};
+
+#endif
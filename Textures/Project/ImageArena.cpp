@@ -0,0 +1,248 @@
+#include "ImageArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace
+{
+	//In front of every block : where it comes from and its size, keeps the block 16 bytes aligned
+	struct alignas(16) BlockHeader
+	{
+		//nullptr for a block from malloc
+		ImageArena* arena;
+		std::size_t size;
+	};
+
+	//Holds the pixels and the zlib buffers of a 1024x1024 RGBA image
+	const std::size_t CHUNK_SIZE = 8 << 20;
+	//Kept by an arena between batches : one huge image must not pin its memory for the life of the thread
+	const std::size_t KEPT_SIZE = 32 << 20;
+
+	std::atomic<bool> enabled{ true };
+	std::mutex registryMutex;
+	//Every arena ever made, and the ones whose thread ended
+	std::vector<ImageArena*> arenas;
+	std::vector<ImageArena*> freeArenas;
+
+	std::size_t blockSize(std::size_t size)
+	{
+		return sizeof(BlockHeader) + ((size + 15) & ~(std::size_t)15);
+	}
+
+	BlockHeader* headerOf(void* pointer)
+	{
+		return (BlockHeader*)pointer - 1;
+	}
+}
+
+//Gives the arena back when its thread ends
+struct ArenaSlot
+{
+	ImageArena* arena = nullptr;
+
+	~ArenaSlot()
+	{
+		if (!arena)
+			return;
+		std::lock_guard<std::mutex> lock(registryMutex);
+		freeArenas.push_back(arena);
+	}
+};
+
+namespace
+{
+	thread_local ArenaSlot threadArena;
+}
+
+ImageArena& ImageArena::local()
+{
+	if (!threadArena.arena)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		if (!freeArenas.empty())
+		{
+			threadArena.arena = freeArenas.back();
+			freeArenas.pop_back();
+		}
+		else
+		{
+			threadArena.arena = new ImageArena();
+			arenas.push_back(threadArena.arena);
+		}
+	}
+	return *threadArena.arena;
+}
+
+void* ImageArena::allocate(std::size_t size)
+{
+	if (enabled.load(std::memory_order_relaxed))
+		return local().bump(size);
+	BlockHeader* header = (BlockHeader*)std::malloc(sizeof(BlockHeader) + size);
+	if (!header)
+		return nullptr;
+	header->arena = nullptr;
+	header->size = size;
+	return header + 1;
+}
+
+void* ImageArena::reallocate(void* pointer, std::size_t size)
+{
+	if (!pointer)
+		return allocate(size);
+	BlockHeader* header = headerOf(pointer);
+	ImageArena* arena = header->arena;
+	if (!arena)
+	{
+		BlockHeader* moved = (BlockHeader*)std::realloc(header, sizeof(BlockHeader) + size);
+		if (!moved)
+			return nullptr;
+		moved->size = size;
+		return moved + 1;
+	}
+
+	//Last block of the arena of this thread : resized where it is while its chunk has room
+	if (arena == threadArena.arena && arena->last == pointer)
+	{
+		const Chunk &current = arena->chunks[arena->chunk];
+		const std::size_t start = (unsigned char*)header - current.memory;
+		if (start + blockSize(size) <= current.size)
+		{
+			arena->offset = start + blockSize(size);
+			header->size = size;
+			arena->peak.store(std::max(arena->peak.load(std::memory_order_relaxed), arena->used()), std::memory_order_relaxed);
+			return pointer;
+		}
+	}
+	void* moved = allocate(size);
+	if (!moved)
+		return nullptr;
+	std::memcpy(moved, pointer, std::min(size, header->size));
+	release(pointer);
+	return moved;
+}
+
+void ImageArena::release(void* pointer)
+{
+	if (!pointer)
+		return;
+	BlockHeader* header = headerOf(pointer);
+	ImageArena* arena = header->arena;
+	if (!arena)
+	{
+		std::free(header);
+		return;
+	}
+	//Freed by its thread right after being allocated (decoder temporaries) : its space is reused at once
+	if (arena == threadArena.arena && arena->last == pointer)
+	{
+		arena->offset -= blockSize(header->size);
+		arena->last = nullptr;
+	}
+	arena->live.fetch_sub(1, std::memory_order_release);
+}
+
+void* ImageArena::bump(std::size_t size)
+{
+	//Every block of the previous batch is freed : start again from the beginning
+	if (live.load(std::memory_order_acquire) == 0 && used() > 0)
+		rewind();
+
+	const std::size_t total = blockSize(size);
+	while (chunk < chunks.size() && offset + total > chunks[chunk].size)
+	{
+		previousChunks += chunks[chunk].size;
+		offset = 0;
+		++chunk;
+	}
+	if (chunk == chunks.size())
+	{
+		Chunk next;
+		next.size = std::max(CHUNK_SIZE, total);
+		next.memory = (unsigned char*)std::malloc(next.size);
+		if (!next.memory)
+			return nullptr;
+		chunks.push_back(next);
+		reserved.fetch_add(next.size, std::memory_order_relaxed);
+	}
+
+	BlockHeader* header = (BlockHeader*)(chunks[chunk].memory + offset);
+	header->arena = this;
+	header->size = size;
+	offset += total;
+	last = (unsigned char*)(header + 1);
+	live.fetch_add(1, std::memory_order_relaxed);
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	peak.store(std::max(peak.load(std::memory_order_relaxed), used()), std::memory_order_relaxed);
+	return last;
+}
+
+void ImageArena::endBatch()
+{
+	ImageArena* arena = threadArena.arena;
+	//A block still in use would be overwritten by the next batch : the arena waits for its release
+	//Rewound even when nothing is used anymore, a big chunk left by the batch is trimmed there
+	if (arena && arena->live.load(std::memory_order_acquire) == 0)
+		arena->rewind();
+}
+
+void ImageArena::rewind()
+{
+	std::size_t total = 0;
+	for (const Chunk &old : chunks)
+		total += old.size;
+	//The batch did not fit in one chunk : a single chunk as big as all of them, the next batch fits in it
+	//Only up to KEPT_SIZE, the rest goes back to the system
+	if (chunks.size() > 1 || total > KEPT_SIZE)
+	{
+		for (const Chunk &old : chunks)
+			std::free(old.memory);
+		chunks.clear();
+		Chunk merged;
+		merged.size = std::min(total, KEPT_SIZE);
+		merged.memory = (unsigned char*)std::malloc(merged.size);
+		if (merged.memory)
+			chunks.push_back(merged);
+		reserved.store(merged.memory ? merged.size : 0, std::memory_order_relaxed);
+	}
+	chunk = 0;
+	offset = 0;
+	previousChunks = 0;
+	last = nullptr;
+	rewinds.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ImageArena::setEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool ImageArena::isEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+ImageArena::Stats ImageArena::getStats()
+{
+	Stats stats;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (const ImageArena* arena : arenas)
+	{
+		stats.peakBytes += arena->peak.load(std::memory_order_relaxed);
+		stats.reservedBytes += arena->reserved.load(std::memory_order_relaxed);
+		stats.allocations += arena->allocations.load(std::memory_order_relaxed);
+		stats.rewinds += arena->rewinds.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void ImageArena::resetStats()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (ImageArena* arena : arenas)
+	{
+		arena->peak.store(0, std::memory_order_relaxed);
+		arena->allocations.store(0, std::memory_order_relaxed);
+		arena->rewinds.store(0, std::memory_order_relaxed);
+	}
+}
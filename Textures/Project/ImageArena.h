@@ -0,0 +1,81 @@
+#pragma once
+#ifndef IMAGE_ARENA_H
+#define IMAGE_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//Allocator of stb_image (STBI_MALLOC / STBI_REALLOC / STBI_FREE, defined next to STB_IMAGE_IMPLEMENTATION)
+//Each decoding thread bumps a pointer in its own arena : no lock, no contention between the workers
+//	- the decoder buffers and the returned pixels come from the arena of the thread calling stbi_load
+//	- any thread may free them, it only counts the live blocks down
+//	- endBatch() ends a decode job : the arena of the calling thread rewinds to its start, every block it
+//	  handed out must be freed by then. A result kept longer (pixels waiting for their upload) is copied
+//	  out of the arena first, else the arena could never rewind while the loading goes on
+//	- without endBatch() an arena still rewinds on its next allocation once every block is freed
+//	- a realloc of the last block grows in place, which is what the zlib decoder of the PNG does
+//The memory of an arena is kept for the next batch up to 32 MB, an arena is reused by a new thread when its own ends
+class ImageArena
+{
+public:
+	struct Stats
+	{
+		//Sum over the arenas of the most bytes each one held at once
+		std::size_t peakBytes = 0;
+		//Memory kept by the arenas
+		std::size_t reservedBytes = 0;
+		unsigned int allocations = 0;
+		//Times an arena went back to its start
+		unsigned int rewinds = 0;
+	};
+
+	static void* allocate(std::size_t size);
+	static void* reallocate(void* pointer, std::size_t size);
+	static void release(void* pointer);
+	//End of the batch decoded by the calling thread, its arena rewinds if every block is freed
+	static void endBatch();
+
+	//false -> malloc / realloc / free, to compare with the system allocator
+	//Blocks from both sources can be freed whatever the setting is now
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+	static Stats getStats();
+	//Peaks and counters start again from the current use
+	static void resetStats();
+
+private:
+	struct Chunk
+	{
+		unsigned char* memory;
+		std::size_t size;
+	};
+
+	std::vector<Chunk> chunks;
+	//Bump pointer : chunk in use and offset in it
+	std::size_t chunk = 0;
+	std::size_t offset = 0;
+	//Bytes of the chunks before the one in use, to know the whole use of the arena
+	std::size_t previousChunks = 0;
+	//Written by the owner thread only, read by getStats()
+	std::atomic<std::size_t> peak{ 0 };
+	std::atomic<std::size_t> reserved{ 0 };
+	//Last block handed out, the only one realloc can grow in place
+	unsigned char* last = nullptr;
+	//Blocks not freed yet, counted down by any thread
+	std::atomic<unsigned int> live{ 0 };
+	std::atomic<unsigned int> allocations{ 0 };
+	std::atomic<unsigned int> rewinds{ 0 };
+
+	//Never deleted, an arena outlives the blocks freed late by other threads
+	ImageArena() = default;
+	//Arena of the calling thread, taken from the free list or created
+	static ImageArena& local();
+	void* bump(std::size_t size);
+	void rewind();
+	std::size_t used() const { return previousChunks + offset; }
+
+	friend struct ArenaSlot;
+};
+
+#endif
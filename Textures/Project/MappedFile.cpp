@@ -0,0 +1,144 @@
+#include "MappedFile.h"
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		std::swap(address, other.address);
+		std::swap(length, other.length);
+		std::swap(opened, other.opened);
+		std::swap(error, other.error);
+#ifdef _WIN32
+		std::swap(fileHandle, other.fileHandle);
+		std::swap(mappingHandle, other.mappingHandle);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		error = "can't open the file (error " + std::to_string(GetLastError()) + ")";
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		error = "can't read the file size (error " + std::to_string(GetLastError()) + ")";
+		close();
+		return false;
+	}
+	length = (std::size_t)fileSize.QuadPart;
+	//An empty file can't be mapped, it is still a valid (empty) content
+	if (length > 0)
+	{
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mappingHandle)
+			address = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (!address)
+		{
+			error = "can't map the file (error " + std::to_string(GetLastError()) + ")";
+			close();
+			return false;
+		}
+	}
+	opened = true;
+	error.clear();
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (address)
+		UnmapViewOfFile(address);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	address = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path)
+{
+	close();
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		error = std::strerror(errno);
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		error = std::strerror(errno);
+		::close(fd);
+		return false;
+	}
+	length = (std::size_t)info.st_size;
+	//An empty file can't be mapped, it is still a valid (empty) content
+	if (length > 0)
+	{
+		void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			error = std::strerror(errno);
+			length = 0;
+			::close(fd);
+			return false;
+		}
+		address = (const char*)mapping;
+	}
+	//The mapping stays valid once the descriptor is closed
+	::close(fd);
+	opened = true;
+	error.clear();
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (address)
+		munmap((void*)address, length);
+	address = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+//Read only memory mapping of a whole file
+//The content is used in place : no stream, no copy into a std::string
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile& operator=(MappedFile &&other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//Map the file, on failure returns false and getError() tells why
+	bool open(const std::string &path);
+	void close();
+
+	bool isOpen() const { return opened; }
+	const char* data() const { return address; }
+	std::size_t size() const { return length; }
+	std::string_view view() const { return std::string_view(address, length); }
+	const std::string& getError() const { return error; }
+
+private:
+	const char* address = nullptr;
+	std::size_t length = 0;
+	bool opened = false;
+	std::string error;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "MaterialTable.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	bool hasTextureStorage()
+	{
+		return hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_storage");
+	}
+
+	bool hasCopyImage()
+	{
+		return hasGLVersion(4, 3) || hasGLExtension("GL_ARB_copy_image");
+	}
+
+	//Rows of the layers are tightly packed, both ways
+	struct PackedRows
+	{
+		GLint unpack = 4, pack = 4;
+
+		PackedRows()
+		{
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack);
+			glGetIntegerv(GL_PACK_ALIGNMENT, &pack);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		}
+		~PackedRows()
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, unpack);
+			glPixelStorei(GL_PACK_ALIGNMENT, pack);
+		}
+	};
+}
+
+bool MaterialTable::Layout::operator==(const Layout &other) const
+{
+	return internalFormat == other.internalFormat && format == other.format && type == other.type
+		&& width == other.width && height == other.height && levelCount == other.levelCount;
+}
+
+std::size_t MaterialTable::Layout::levelSize(unsigned int level) const
+{
+	return cookedLevelSize(internalFormat, std::max(1, width >> level), std::max(1, height >> level));
+}
+
+MaterialTable::MaterialTable(unsigned int initialLayers)
+	: initialLayers(std::max(1u, initialLayers))
+{
+}
+
+MaterialTable::~MaterialTable()
+{
+	GLStateCache &state = GLStateCache::get();
+	for (TextureArray &array : arrays)
+	{
+		state.forgetTexture(array.texture);
+		glDeleteTextures(1, &array.texture);
+	}
+}
+
+bool MaterialTable::add(const std::string &name, Material &material)
+{
+	if (const Material* existing = find(name))
+	{
+		material = *existing;
+		return true;
+	}
+	CookedTexture texture;
+	if (!texture.open(name))
+		return false;
+	return add(name, texture, material);
+}
+
+bool MaterialTable::add(const std::string &name, const CookedTexture &texture, Material &material)
+{
+	if (const Material* existing = find(name))
+	{
+		material = *existing;
+		return true;
+	}
+	const CookedTextureHeader &header = texture.getHeader();
+	if (!texture.isSupported())
+	{
+		std::cout << "ERROR::MATERIAL::FORMAT_NOT_SUPPORTED " << std::hex << header.internalFormat << std::dec << " " << name << std::endl;
+		return false;
+	}
+	const Layout layout = { header.internalFormat, header.format, header.type, (int)header.width, (int)header.height, header.levelCount };
+	std::vector<const void*> levels;
+	for (unsigned int level = 0; level < texture.getLevelCount(); ++level)
+		levels.push_back(texture.getLevelData(level));
+	return addLevels(name, layout, levels, material);
+}
+
+bool MaterialTable::add(const std::string &name, const unsigned char* pixels, int width, int height, int channels, Material &material, const MipOptions &options)
+{
+	if (const Material* existing = find(name))
+	{
+		material = *existing;
+		return true;
+	}
+	Layout layout = { 0, 0, GL_UNSIGNED_BYTE, width, height, 1 };
+	switch (channels)
+	{
+	case 1: layout.internalFormat = GL_R8; layout.format = GL_RED; break;
+	case 2: layout.internalFormat = GL_RG8; layout.format = GL_RG; break;
+	case 3: layout.internalFormat = GL_RGB8; layout.format = GL_RGB; break;
+	case 4: layout.internalFormat = GL_RGBA8; layout.format = GL_RGBA; break;
+	default:
+		std::cout << "ERROR::MATERIAL::UNSUPPORTED_CHANNELS " << name << std::endl;
+		return false;
+	}
+
+	const std::vector<MipLevel> mips = buildMipChain(pixels, width, height, channels, options);
+	std::vector<const void*> levels;
+	levels.push_back(pixels);
+	for (const MipLevel &mip : mips)
+		levels.push_back(mip.pixels.data());
+	layout.levelCount = (unsigned int)levels.size();
+	return addLevels(name, layout, levels, material);
+}
+
+const Material* MaterialTable::find(const std::string &name) const
+{
+	auto found = materials.find(name);
+	return found == materials.end() ? nullptr : &found->second;
+}
+
+unsigned int MaterialTable::getTexture(unsigned int array) const
+{
+	return arrays[array].texture;
+}
+
+void MaterialTable::bind(unsigned int unit, const Material &material) const
+{
+	GLStateCache::get().bindTexture(unit, GL_TEXTURE_2D_ARRAY, arrays[material.array].texture);
+}
+
+bool MaterialTable::addLevels(const std::string &name, const Layout &layout, const std::vector<const void*> &levels, Material &material)
+{
+	const unsigned int index = arrayFor(layout);
+	TextureArray &array = arrays[index];
+
+	GLStateCache &state = GLStateCache::get();
+	state.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+	//The levels come from client memory, not from a pixel unpack buffer
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	PackedRows packedRows;
+	for (unsigned int level = 0; level < layout.levelCount; ++level)
+	{
+		const GLsizei width = std::max(1, layout.width >> level), height = std::max(1, layout.height >> level);
+		//One layer deep at depth layerCount
+		if (layout.format == 0)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, array.layerCount, width, height, 1, layout.internalFormat, (GLsizei)layout.levelSize(level), levels[level]);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, array.layerCount, width, height, 1, layout.format, layout.type, levels[level]);
+	}
+
+	material.array = index;
+	material.layer = array.layerCount++;
+	materials[name] = material;
+	return true;
+}
+
+unsigned int MaterialTable::arrayFor(const Layout &layout)
+{
+	for (unsigned int i = 0; i < arrays.size(); ++i)
+		if (arrays[i].layout == layout && (arrays[i].layerCount < arrays[i].capacity || grow(arrays[i])))
+			return i;
+
+	//First texture of that size and format, or every array of it is at the layer limit
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	TextureArray array;
+	array.layout = layout;
+	array.capacity = std::min(initialLayers, (unsigned int)maxLayers);
+	array.texture = createTexture(layout, array.capacity);
+	array.layerCount = 0;
+	arrays.push_back(array);
+	return (unsigned int)arrays.size() - 1;
+}
+
+unsigned int MaterialTable::createTexture(const Layout &layout, unsigned int capacity) const
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLStateCache &state = GLStateCache::get();
+	state.bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, layout.levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, layout.levelCount - 1);
+
+	if (hasTextureStorage())
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, layout.levelCount, layout.internalFormat, layout.width, layout.height, capacity);
+		return texture;
+	}
+	//Null data must not be read as an offset in a pixel unpack buffer
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	for (unsigned int level = 0; level < layout.levelCount; ++level)
+	{
+		const GLsizei width = std::max(1, layout.width >> level), height = std::max(1, layout.height >> level);
+		if (layout.format == 0)
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, layout.internalFormat, width, height, capacity, 0, (GLsizei)(layout.levelSize(level) * capacity), nullptr);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, layout.internalFormat, width, height, capacity, 0, layout.format, layout.type, nullptr);
+	}
+	return texture;
+}
+
+bool MaterialTable::grow(TextureArray &array)
+{
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (array.capacity >= (unsigned int)maxLayers)
+		return false;
+	const unsigned int capacity = std::min(array.capacity * 2, (unsigned int)maxLayers);
+	const unsigned int texture = createTexture(array.layout, capacity);
+	const Layout &layout = array.layout;
+
+	GLStateCache &state = GLStateCache::get();
+	std::size_t copied = 0;
+	if (hasCopyImage())
+	{
+		//Texture to texture, every layer of a level in one call
+		for (unsigned int level = 0; level < layout.levelCount; ++level)
+		{
+			const GLsizei width = std::max(1, layout.width >> level), height = std::max(1, layout.height >> level);
+			glCopyImageSubData(array.texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, array.layerCount);
+			copied += layout.levelSize(level) * array.layerCount;
+		}
+	}
+	else
+	{
+		//GL 3.3 : read back into a buffer object and upload from it, the texels stay on the GPU
+		//glGet(Compressed)TexImage returns every layer of the level, one after the other
+		std::vector<std::size_t> offsets;
+		std::size_t size = 0;
+		for (unsigned int level = 0; level < layout.levelCount; ++level)
+		{
+			offsets.push_back(size);
+			size += layout.levelSize(level) * array.capacity;
+		}
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_COPY);
+		PackedRows packedRows;
+
+		state.bindTexture(0, GL_TEXTURE_2D_ARRAY, array.texture);
+		for (unsigned int level = 0; level < layout.levelCount; ++level)
+		{
+			if (layout.format == 0)
+				glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level, (void*)offsets[level]);
+			else
+				glGetTexImage(GL_TEXTURE_2D_ARRAY, level, layout.format, layout.type, (void*)offsets[level]);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		state.bindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+		for (unsigned int level = 0; level < layout.levelCount; ++level)
+		{
+			const GLsizei width = std::max(1, layout.width >> level), height = std::max(1, layout.height >> level);
+			const std::size_t levelSize = layout.levelSize(level) * array.layerCount;
+			if (layout.format == 0)
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, array.layerCount, layout.internalFormat, (GLsizei)levelSize, (void*)offsets[level]);
+			else
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, array.layerCount, layout.format, layout.type, (void*)offsets[level]);
+			copied += levelSize;
+		}
+		state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		state.forgetBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+	growBytes += copied;
+
+	state.forgetTexture(array.texture);
+	glDeleteTextures(1, &array.texture);
+	array.texture = texture;
+	array.capacity = capacity;
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <glad/glad.h>
+#include "CookedTexture.h"
+#include "MipGenerator.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Textures of the same size and format are stored as the layers of one GL_TEXTURE_2D_ARRAY :
+//draws using any of them need no texture bind in between, the layer is given per vertex / per instance
+//(aLayers of vShader.vs, TEXTURE_ARRAY variant of fShader.fs)
+//A new size / format gets its own array, a full array is reallocated twice as big on the GPU
+struct Material
+{
+	//Index of the array in the table, not the texture name : growing an array changes its texture
+	unsigned int array;
+	unsigned int layer;
+};
+
+class MaterialTable
+{
+public:
+	//initialLayers : layers allocated with every new array
+	MaterialTable(unsigned int initialLayers = 16);
+	~MaterialTable();
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	//Cooked texture (.ctex) : its levels are copied straight from the mapping
+	//Adding a name twice returns the material already there
+	//Returns false and prints why when the file can't be read or its format sampled
+	bool add(const std::string &name, Material &material);
+	bool add(const std::string &name, const CookedTexture &texture, Material &material);
+	//Tightly packed 8 bits image of 1 to 4 channels, the mip levels are built by buildMipChain
+	bool add(const std::string &name, const unsigned char* pixels, int width, int height, int channels, Material &material, const MipOptions &options = MipOptions());
+
+	//nullptr when the name was never added
+	const Material* find(const std::string &name) const;
+	//Texture of the array, GL_TEXTURE_2D_ARRAY
+	unsigned int getTexture(unsigned int array) const;
+	//Binds the array holding the material, dropped by the cache while it stays the same
+	void bind(unsigned int unit, const Material &material) const;
+
+	unsigned int getArrayCount() const { return (unsigned int)arrays.size(); }
+	unsigned int getMaterialCount() const { return (unsigned int)materials.size(); }
+	//Bytes copied on the GPU by the arrays that had to grow
+	std::size_t getGrowBytes() const { return growBytes; }
+
+private:
+	//Everything a layer must share with the others of its array
+	struct Layout
+	{
+		GLenum internalFormat;
+		//Both 0 for a compressed format
+		GLenum format, type;
+		int width, height;
+		unsigned int levelCount;
+
+		bool operator==(const Layout &other) const;
+		std::size_t levelSize(unsigned int level) const;
+	};
+	struct TextureArray
+	{
+		Layout layout;
+		unsigned int texture;
+		unsigned int capacity;
+		unsigned int layerCount;
+	};
+
+	std::vector<TextureArray> arrays;
+	std::unordered_map<std::string, Material> materials;
+	unsigned int initialLayers;
+	std::size_t growBytes = 0;
+
+	bool addLevels(const std::string &name, const Layout &layout, const std::vector<const void*> &levels, Material &material);
+	//Array with a free layer for that layout, grown or created when needed
+	unsigned int arrayFor(const Layout &layout);
+	unsigned int createTexture(const Layout &layout, unsigned int capacity) const;
+	bool grow(TextureArray &array);
+};
+
+#endif
@@ -0,0 +1,1012 @@
+#include "MeshImporter.h"
+#include "CookedMesh.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+	const std::uint32_t NO_INDEX = 0xFFFFFFFF;
+
+	//body(first, last) over [0, count) : a few ranges per worker so that a slow one does not keep
+	//the others waiting, or everything on this thread when there are less than two grains of work
+	template<typename Body>
+	void parallelFor(ThreadPool* pool, std::size_t count, std::size_t grain, const Body &body)
+	{
+		const std::size_t jobCount = pool ? std::min<std::size_t>(pool->getWorkerCount() * 4, (count + grain - 1) / grain) : 1;
+		if (jobCount <= 1)
+		{
+			body(0, count);
+			return;
+		}
+		for (std::size_t job = 0; job < jobCount; ++job)
+		{
+			const std::size_t first = count * job / jobCount, last = count * (job + 1) / jobCount;
+			pool->submit([&body, first, last] { body(first, last); });
+		}
+		pool->wait();
+	}
+
+	bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p < end && isBlank(*p))
+			++p;
+		return p;
+	}
+
+	//Decimal number like strtod, without locale nor allocation : [sign] digits [. digits] [e [sign] digits]
+	//nullptr when there is no digit
+	const char* parseNumber(const char* p, const char* end, double &value)
+	{
+		static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		std::uint64_t mantissa = 0;
+		int exponent = 0;
+		bool digits = false;
+		//Past 18 digits the next ones only move the exponent
+		for (; p < end && *p >= '0' && *p <= '9'; ++p, digits = true)
+		{
+			if (mantissa < 100000000000000000ull)
+				mantissa = mantissa * 10 + (*p - '0');
+			else
+				++exponent;
+		}
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p, digits = true)
+			{
+				if (mantissa < 100000000000000000ull)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					--exponent;
+				}
+			}
+		}
+		if (!digits)
+			return nullptr;
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* q = p + 1;
+			bool negativeExponent = false;
+			if (q < end && (*q == '-' || *q == '+'))
+				negativeExponent = *q++ == '-';
+			int written = 0;
+			bool exponentDigits = false;
+			for (; q < end && *q >= '0' && *q <= '9'; ++q, exponentDigits = true)
+				if (written < 100000)
+					written = written * 10 + (*q - '0');
+			//"1e" alone is the number 1 followed by something else
+			if (exponentDigits)
+			{
+				exponent += negativeExponent ? -written : written;
+				p = q;
+			}
+		}
+		double result = (double)mantissa;
+		if (exponent < 0)
+			result = exponent >= -22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+		else if (exponent > 0)
+			result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+		value = negative ? -result : result;
+		return p;
+	}
+
+	const char* parseFloat(const char* p, const char* end, float &value)
+	{
+		double number;
+		p = parseNumber(skipBlanks(p, end), end, number);
+		if (p)
+			value = (float)number;
+		return p;
+	}
+
+	const char* parseInteger(const char* p, const char* end, long long &value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		const char* start = p;
+		long long result = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			if (result < 1000000000000ll)
+				result = result * 10 + (*p - '0');
+		if (p == start)
+			return nullptr;
+		value = negative ? -result : result;
+		return p;
+	}
+
+	std::size_t hashCorner(std::uint32_t position, std::uint32_t texCoord, std::uint32_t normal)
+	{
+		std::uint64_t hash = position * 0x9E3779B97F4A7C15ull;
+		hash ^= (texCoord + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		hash ^= (normal + 0x165667B19E3779F9ull) * 0x27D4EB2F165667C5ull;
+		return (std::size_t)(hash ^ (hash >> 29));
+	}
+
+	//Area weighted normals of the vertices left at 0 by the file, over the triangles of the range
+	void computeMissingNormals(ImportedMesh &mesh, std::size_t firstVertex, std::size_t vertexCount, std::size_t firstIndex, std::size_t indexCount)
+	{
+		std::vector<bool> missing(vertexCount);
+		bool any = false;
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			const float* n = mesh.vertices[firstVertex + v].normal.v;
+			missing[v] = n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f;
+			any = any || missing[v];
+		}
+		if (!any)
+			return;
+		for (std::size_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3)
+		{
+			MeshVertex* corner[3];
+			for (int c = 0; c < 3; ++c)
+				corner[c] = &mesh.vertices[mesh.indices[i + c]];
+			const float* a = corner[0]->position.v;
+			const float* b = corner[1]->position.v;
+			const float* d = corner[2]->position.v;
+			const float ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+			const float vx = d[0] - a[0], vy = d[1] - a[1], vz = d[2] - a[2];
+			const float normal[3] = { uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+			for (int c = 0; c < 3; ++c)
+			{
+				if (!missing[mesh.indices[i + c] - firstVertex])
+					continue;
+				for (int k = 0; k < 3; ++k)
+					corner[c]->normal.v[k] += normal[k];
+			}
+		}
+		for (std::size_t v = 0; v < vertexCount; ++v)
+		{
+			if (!missing[v])
+				continue;
+			float* n = mesh.vertices[firstVertex + v].normal.v;
+			const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 0.0f)
+				for (int k = 0; k < 3; ++k)
+					n[k] /= length;
+		}
+	}
+
+	//---------- OBJ ----------
+
+	enum class ObjLine
+	{
+		Other,
+		Position,
+		TexCoord,
+		Normal,
+		Face
+	};
+
+	//Kind of the line at p, p moved past its keyword
+	ObjLine objLineType(const char* &p, const char* end)
+	{
+		p = skipBlanks(p, end);
+		if (end - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+		{
+			p += 2;
+			return ObjLine::Position;
+		}
+		if (end - p >= 3 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && isBlank(p[2]))
+		{
+			const ObjLine type = p[1] == 't' ? ObjLine::TexCoord : ObjLine::Normal;
+			p += 3;
+			return type;
+		}
+		if (end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+		{
+			p += 2;
+			return ObjLine::Face;
+		}
+		return ObjLine::Other;
+	}
+
+	//Whole lines of the file, parsed by one job
+	struct ObjSlice
+	{
+		const char* begin;
+		const char* end;
+		//Counted by the first pass
+		std::size_t positions = 0, texCoords = 0, normals = 0, triangles = 0;
+		//Rank of the first of each in the whole file
+		std::size_t firstPosition = 0, firstTexCoord = 0, firstNormal = 0, firstTriangle = 0;
+		bool failed = false;
+	};
+
+	//What the second pass writes : the attributes of the file and, per triangle corner,
+	//its position / uv / normal indices (NO_INDEX when the face gives none)
+	struct ObjData
+	{
+		std::vector<float> positions, texCoords, normals;
+		std::vector<std::uint32_t> corners;
+		std::size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+	};
+
+	void countObjSlice(ObjSlice &slice)
+	{
+		for (const char* line = slice.begin; line < slice.end;)
+		{
+			const char* next = (const char*)std::memchr(line, '\n', slice.end - line);
+			const char* lineEnd = next ? next : slice.end;
+			const char* p = line;
+			switch (objLineType(p, lineEnd))
+			{
+			case ObjLine::Position: ++slice.positions; break;
+			case ObjLine::TexCoord: ++slice.texCoords; break;
+			case ObjLine::Normal: ++slice.normals; break;
+			case ObjLine::Face:
+			{
+				std::size_t corners = 0;
+				for (p = skipBlanks(p, lineEnd); p < lineEnd && *p != '#'; p = skipBlanks(p, lineEnd))
+				{
+					++corners;
+					while (p < lineEnd && !isBlank(*p))
+						++p;
+				}
+				if (corners >= 3)
+					slice.triangles += corners - 2;
+				break;
+			}
+			default: break;
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	//One v, v/vt, v//vn or v/vt/vn of a face, the negative indices counted back from the current element
+	const char* parseObjCorner(const char* p, const char* end, const std::size_t current[3], const std::size_t total[3], std::uint32_t corner[3])
+	{
+		corner[0] = corner[1] = corner[2] = NO_INDEX;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (k > 0)
+			{
+				if (p >= end || *p != '/')
+					break;
+				++p;
+				//v//vn : no uv
+				if (p < end && *p == '/')
+					continue;
+			}
+			long long index;
+			p = parseInteger(p, end, index);
+			if (!p)
+				return nullptr;
+			const long long resolved = index > 0 ? index - 1 : (long long)current[k] + index;
+			if (index == 0 || resolved < 0 || resolved >= (long long)total[k])
+				return nullptr;
+			corner[k] = (std::uint32_t)resolved;
+		}
+		return p;
+	}
+
+	void parseObjSlice(ObjSlice &slice, ObjData &data)
+	{
+		std::size_t position = slice.firstPosition, texCoord = slice.firstTexCoord, normal = slice.firstNormal;
+		std::uint32_t* corners = data.corners.data() + slice.firstTriangle * 9;
+		const std::size_t total[3] = { data.positionCount, data.texCoordCount, data.normalCount };
+		for (const char* line = slice.begin; line < slice.end && !slice.failed;)
+		{
+			const char* next = (const char*)std::memchr(line, '\n', slice.end - line);
+			const char* lineEnd = next ? next : slice.end;
+			const char* p = line;
+			switch (objLineType(p, lineEnd))
+			{
+			case ObjLine::Position:
+			{
+				float* out = data.positions.data() + position++ * 3;
+				for (int k = 0; k < 3 && p; ++k)
+					p = parseFloat(p, lineEnd, out[k]);
+				slice.failed = !p;
+				break;
+			}
+			case ObjLine::TexCoord:
+			{
+				float* out = data.texCoords.data() + texCoord++ * 2;
+				p = parseFloat(p, lineEnd, out[0]);
+				//The v is optional
+				if (p && !parseFloat(p, lineEnd, out[1]))
+					out[1] = 0.0f;
+				slice.failed = !p;
+				break;
+			}
+			case ObjLine::Normal:
+			{
+				float* out = data.normals.data() + normal++ * 3;
+				for (int k = 0; k < 3 && p; ++k)
+					p = parseFloat(p, lineEnd, out[k]);
+				slice.failed = !p;
+				break;
+			}
+			case ObjLine::Face:
+			{
+				const std::size_t current[3] = { position, texCoord, normal };
+				std::uint32_t first[3], previous[3], corner[3];
+				int count = 0;
+				for (p = skipBlanks(p, lineEnd); p < lineEnd && *p != '#'; p = skipBlanks(p, lineEnd))
+				{
+					p = parseObjCorner(p, lineEnd, current, total, corner);
+					if (!p)
+					{
+						slice.failed = true;
+						break;
+					}
+					//Fan around the first corner
+					if (count == 0)
+						std::memcpy(first, corner, sizeof(first));
+					else if (count >= 2)
+					{
+						std::memcpy(corners, first, sizeof(first));
+						std::memcpy(corners + 3, previous, sizeof(previous));
+						std::memcpy(corners + 6, corner, sizeof(corner));
+						corners += 9;
+					}
+					std::memcpy(previous, corner, sizeof(previous));
+					++count;
+				}
+				break;
+			}
+			default: break;
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	//---------- glTF ----------
+
+	//Just enough JSON for the glTF scene description, the strings point into the file
+	struct Json
+	{
+		enum Type { Null, Bool, Number, String, Array, Object };
+		Type type = Null;
+		double number = 0.0;
+		std::string_view string;
+		//Elements of an array, values of an object
+		std::vector<Json> items;
+		std::vector<std::string_view> keys;
+
+		const Json* get(std::string_view key) const
+		{
+			for (std::size_t i = 0; i < keys.size(); ++i)
+				if (keys[i] == key)
+					return &items[i];
+			return nullptr;
+		}
+		const Json* at(std::size_t i) const
+		{
+			return type == Array && i < items.size() ? &items[i] : nullptr;
+		}
+		double numberOr(std::string_view key, double fallback) const
+		{
+			const Json* value = get(key);
+			return value && value->type == Number ? value->number : fallback;
+		}
+		//-1 when the key is missing or not an index
+		long long indexOf(std::string_view key) const
+		{
+			std::size_t index;
+			return get(key) && sizeOr(key, 0, 2147483647.0, index) ? (long long)index : -1;
+		}
+		//Whole number in [0, limit], fallback when the key is missing, false when it is anything else
+		//Checked as a double first : converting one out of range to an integer is undefined
+		bool sizeOr(std::string_view key, std::size_t fallback, double limit, std::size_t &size) const
+		{
+			const Json* value = get(key);
+			if (!value)
+			{
+				size = fallback;
+				return true;
+			}
+			if (value->type != Number || !(value->number >= 0.0 && value->number <= limit) || value->number != std::floor(value->number))
+				return false;
+			size = (std::size_t)value->number;
+			return true;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* begin, const char* end)
+			: p(begin), end(end)
+		{
+		}
+
+		bool parse(Json &value, int depth = 0)
+		{
+			p = skipSpaces();
+			if (p >= end || depth > 64)
+				return false;
+			switch (*p)
+			{
+			case '{':
+			{
+				value.type = Json::Object;
+				++p;
+				if ((p = skipSpaces()) < end && *p == '}')
+				{
+					++p;
+					return true;
+				}
+				for (;;)
+				{
+					std::string_view key;
+					if (!parseString(key))
+						return false;
+					if ((p = skipSpaces()) >= end || *p++ != ':')
+						return false;
+					value.keys.push_back(key);
+					value.items.emplace_back();
+					if (!parse(value.items.back(), depth + 1))
+						return false;
+					if ((p = skipSpaces()) >= end)
+						return false;
+					if (*p == '}')
+					{
+						++p;
+						return true;
+					}
+					if (*p++ != ',')
+						return false;
+				}
+			}
+			case '[':
+			{
+				value.type = Json::Array;
+				++p;
+				if ((p = skipSpaces()) < end && *p == ']')
+				{
+					++p;
+					return true;
+				}
+				for (;;)
+				{
+					value.items.emplace_back();
+					if (!parse(value.items.back(), depth + 1))
+						return false;
+					if ((p = skipSpaces()) >= end)
+						return false;
+					if (*p == ']')
+					{
+						++p;
+						return true;
+					}
+					if (*p++ != ',')
+						return false;
+				}
+			}
+			case '"':
+				value.type = Json::String;
+				return parseString(value.string);
+			case 't': value.type = Json::Bool; value.number = 1.0; return word("true");
+			case 'f': value.type = Json::Bool; return word("false");
+			case 'n': return word("null");
+			default:
+				value.type = Json::Number;
+				p = parseNumber(p, end, value.number);
+				return p != nullptr;
+			}
+		}
+
+	private:
+		const char* p;
+		const char* end;
+
+		const char* skipSpaces() const
+		{
+			const char* q = p;
+			while (q < end && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n'))
+				++q;
+			return q;
+		}
+
+		//The escapes stay as they are, the glTF keys and the strings read here have none
+		bool parseString(std::string_view &string)
+		{
+			p = skipSpaces();
+			if (p >= end || *p != '"')
+				return false;
+			const char* start = ++p;
+			while (p < end && *p != '"')
+				p += *p == '\\' ? 2 : 1;
+			if (p >= end)
+				return false;
+			string = std::string_view(start, p - start);
+			++p;
+			return true;
+		}
+
+		bool word(const char* text)
+		{
+			const std::size_t length = std::strlen(text);
+			if ((std::size_t)(end - p) < length || std::memcmp(p, text, length) != 0)
+				return false;
+			p += length;
+			return true;
+		}
+	};
+
+	//Elements of an accessor in the binary chunk
+	struct AccessorView
+	{
+		const unsigned char* data = nullptr;
+		std::size_t stride = 0;
+		std::size_t count = 0;
+		int componentType = 0;
+		int components = 0;
+		bool normalized = false;
+
+		float read(std::size_t i, int component) const
+		{
+			const unsigned char* element = data + i * stride;
+			switch (componentType)
+			{
+			case 5126: { float value; std::memcpy(&value, element + component * 4, 4); return value; }
+			case 5121: { const float value = element[component]; return normalized ? value / 255.0f : value; }
+			case 5123: { std::uint16_t value; std::memcpy(&value, element + component * 2, 2); return normalized ? value / 65535.0f : value; }
+			case 5120: { const float value = (std::int8_t)element[component]; return normalized ? std::max(value / 127.0f, -1.0f) : value; }
+			case 5122: { std::int16_t value; std::memcpy(&value, element + component * 2, 2); return normalized ? std::max(value / 32767.0f, -1.0f) : value; }
+			case 5125: { std::uint32_t value; std::memcpy(&value, element + component * 4, 4); return (float)value; }
+			default: return 0.0f;
+			}
+		}
+		std::uint32_t readIndex(std::size_t i) const
+		{
+			const unsigned char* element = data + i * stride;
+			switch (componentType)
+			{
+			case 5121: return element[0];
+			case 5123: { std::uint16_t value; std::memcpy(&value, element, 2); return value; }
+			case 5125: { std::uint32_t value; std::memcpy(&value, element, 4); return value; }
+			default: return NO_INDEX;
+			}
+		}
+	};
+
+	int componentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case 5120: case 5121: return 1;
+		case 5122: case 5123: return 2;
+		case 5125: case 5126: return 4;
+		default: return 0;
+		}
+	}
+
+	int componentCount(std::string_view type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	//Only the binary chunk of the .glb (buffer 0 without uri) is read, no external .bin
+	const char* resolveAccessor(const Json &root, long long index, const unsigned char* bin, std::size_t binSize, AccessorView &view)
+	{
+		const Json* accessors = root.get("accessors");
+		const Json* accessor = accessors ? accessors->at((std::size_t)index) : nullptr;
+		if (index < 0 || !accessor)
+			return "BAD_ACCESSOR";
+		if (accessor->get("sparse"))
+			return "SPARSE_ACCESSOR";
+		const Json* type = accessor->get("type");
+		std::size_t componentType;
+		if (!accessor->sizeOr("componentType", 0, 65535.0, componentType))
+			return "BAD_ACCESSOR_TYPE";
+		view.componentType = (int)componentType;
+		view.components = type && type->type == Json::String ? componentCount(type->string) : 0;
+		//Below NO_INDEX : a vertex or an index past it could not be numbered
+		if (!accessor->sizeOr("count", 0, (double)NO_INDEX - 1.0, view.count))
+			return "BAD_ACCESSOR_COUNT";
+		const Json* normalized = accessor->get("normalized");
+		view.normalized = normalized && normalized->type == Json::Bool && normalized->number != 0.0;
+		const std::size_t elementSize = (std::size_t)componentSize(view.componentType) * view.components;
+		if (elementSize == 0)
+			return "BAD_ACCESSOR_TYPE";
+
+		const Json* bufferViews = root.get("bufferViews");
+		const Json* bufferView = bufferViews ? bufferViews->at((std::size_t)accessor->indexOf("bufferView")) : nullptr;
+		if (accessor->indexOf("bufferView") < 0 || !bufferView)
+			return "BAD_BUFFER_VIEW";
+		if (bufferView->numberOr("buffer", 0) != 0 || !bin)
+			return "EXTERNAL_BUFFER";
+		//Nothing valid is past the end of the binary chunk
+		std::size_t viewOffset, viewLength, offset;
+		const double limit = (double)binSize;
+		if (!bufferView->sizeOr("byteOffset", 0, limit, viewOffset) || !bufferView->sizeOr("byteLength", 0, limit, viewLength)
+			|| !bufferView->sizeOr("byteStride", 0, limit, view.stride))
+			return "TRUNCATED_BUFFER_VIEW";
+		if (!accessor->sizeOr("byteOffset", 0, limit, offset))
+			return "TRUNCATED_ACCESSOR";
+		if (view.stride == 0)
+			view.stride = elementSize;
+		if (viewOffset > binSize || viewLength > binSize - viewOffset)
+			return "TRUNCATED_BUFFER_VIEW";
+		//Divided rather than multiplied, like CookedMesh::open : a corrupt count can't wrap around
+		if (view.count > 0 && (offset > viewLength || elementSize > viewLength - offset
+			|| view.count - 1 > (viewLength - offset - elementSize) / view.stride))
+			return "TRUNCATED_ACCESSOR";
+		view.data = bin + viewOffset + offset;
+		return nullptr;
+	}
+
+	std::uint32_t readUint32(const char* data)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	//Lower case, with its dot
+	std::string extensionOf(const std::string &path)
+	{
+		std::string extension = std::filesystem::path(path).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		return extension;
+	}
+
+	bool fail(const char* format, const char* reason, const std::string &name)
+	{
+		std::cout << "ERROR::MESH::" << format << "::" << reason << " " << name << std::endl;
+		return false;
+	}
+}
+
+bool importObj(const char* data, std::size_t size, const std::string &name, ImportedMesh &mesh, ThreadPool* pool)
+{
+	//Slices of whole lines, cut on the first line break past an even share
+	const std::size_t sliceCount = pool ? std::max<std::size_t>(1, std::min<std::size_t>(pool->getWorkerCount() * 4, size >> 16)) : 1;
+	std::vector<ObjSlice> slices;
+	const char* end = data + size;
+	const char* begin = data;
+	for (std::size_t s = 0; s < sliceCount && begin < end; ++s)
+	{
+		const char* cut = s + 1 == sliceCount ? end : std::max(begin, data + size * (s + 1) / sliceCount);
+		if (cut < end)
+		{
+			const char* lineBreak = (const char*)std::memchr(cut, '\n', end - cut);
+			cut = lineBreak ? lineBreak + 1 : end;
+		}
+		ObjSlice slice;
+		slice.begin = begin;
+		slice.end = cut;
+		slices.push_back(slice);
+		begin = cut;
+	}
+
+	//Count, then everything is allocated once and each slice writes at its own offset
+	parallelFor(pool, slices.size(), 1, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t s = first; s < last; ++s)
+			countObjSlice(slices[s]);
+	});
+	ObjData objData;
+	std::size_t triangleCount = 0;
+	for (ObjSlice &slice : slices)
+	{
+		slice.firstPosition = objData.positionCount;
+		slice.firstTexCoord = objData.texCoordCount;
+		slice.firstNormal = objData.normalCount;
+		slice.firstTriangle = triangleCount;
+		objData.positionCount += slice.positions;
+		objData.texCoordCount += slice.texCoords;
+		objData.normalCount += slice.normals;
+		triangleCount += slice.triangles;
+	}
+	if (triangleCount == 0)
+		return fail("OBJ", "NO_TRIANGLES", name);
+	if (triangleCount * 3 > NO_INDEX)
+		return fail("OBJ", "TOO_MANY_TRIANGLES", name);
+	objData.positions.resize(objData.positionCount * 3);
+	objData.texCoords.resize(objData.texCoordCount * 2);
+	objData.normals.resize(objData.normalCount * 3);
+	objData.corners.resize(triangleCount * 9);
+
+	parallelFor(pool, slices.size(), 1, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t s = first; s < last; ++s)
+			parseObjSlice(slices[s], objData);
+	});
+	for (const ObjSlice &slice : slices)
+		if (slice.failed)
+			return fail("OBJ", "PARSE_ERROR", name);
+
+	//Same position / uv / normal triple -> same vertex, through an open addressing table sized once
+	const std::size_t cornerCount = triangleCount * 3;
+	std::size_t tableSize = 1;
+	while (tableSize < cornerCount * 2)
+		tableSize <<= 1;
+	std::vector<std::uint32_t> table(tableSize, NO_INDEX);
+	//Corner where each vertex was first seen
+	std::vector<std::uint32_t> firstCorner;
+	firstCorner.reserve(std::min(cornerCount, objData.positionCount * 2));
+	mesh.indices.resize(cornerCount);
+	const std::uint32_t* corners = objData.corners.data();
+	for (std::size_t c = 0; c < cornerCount; ++c)
+	{
+		const std::uint32_t* key = corners + c * 3;
+		std::size_t slot = hashCorner(key[0], key[1], key[2]) & (tableSize - 1);
+		for (;; slot = (slot + 1) & (tableSize - 1))
+		{
+			const std::uint32_t vertex = table[slot];
+			if (vertex == NO_INDEX)
+			{
+				table[slot] = (std::uint32_t)firstCorner.size();
+				mesh.indices[c] = (std::uint32_t)firstCorner.size();
+				firstCorner.push_back((std::uint32_t)c);
+				break;
+			}
+			if (std::memcmp(corners + firstCorner[vertex] * 3, key, 3 * sizeof(std::uint32_t)) == 0)
+			{
+				mesh.indices[c] = vertex;
+				break;
+			}
+		}
+	}
+	std::vector<std::uint32_t>().swap(table);
+
+	mesh.vertices.resize(firstCorner.size());
+	parallelFor(pool, mesh.vertices.size(), 4096, [&](std::size_t first, std::size_t last)
+	{
+		for (std::size_t v = first; v < last; ++v)
+		{
+			const std::uint32_t* key = corners + firstCorner[v] * 3;
+			MeshVertex &out = mesh.vertices[v];
+			std::memcpy(out.position.v, objData.positions.data() + key[0] * 3, 3 * sizeof(float));
+			if (key[1] != NO_INDEX)
+				std::memcpy(out.texCoord.v, objData.texCoords.data() + key[1] * 2, 2 * sizeof(float));
+			if (key[2] != NO_INDEX)
+				std::memcpy(out.normal.v, objData.normals.data() + key[2] * 3, 3 * sizeof(float));
+		}
+	});
+	computeMissingNormals(mesh, 0, mesh.vertices.size(), 0, mesh.indices.size());
+	return true;
+}
+
+bool importGlb(const char* data, std::size_t size, const std::string &name, ImportedMesh &mesh, ThreadPool* pool)
+{
+	//Header | JSON chunk | BIN chunk, each chunk being its length, its type and its bytes
+	if (size < 20 || std::memcmp(data, "glTF", 4) != 0)
+		return fail("GLB", "BAD_MAGIC", name);
+	if (readUint32(data + 4) != 2)
+		return fail("GLB", "BAD_VERSION", name);
+	const std::size_t jsonLength = readUint32(data + 12);
+	if (readUint32(data + 16) != 0x4E4F534A || jsonLength > size - 20)
+		return fail("GLB", "BAD_JSON_CHUNK", name);
+	const char* json = data + 20;
+	const unsigned char* bin = nullptr;
+	std::size_t binSize = 0;
+	const std::size_t binChunk = 20 + ((jsonLength + 3) & ~(std::size_t)3);
+	if (binChunk + 8 <= size && readUint32(data + binChunk + 4) == 0x004E4942)
+	{
+		binSize = readUint32(data + binChunk);
+		if (binSize > size - binChunk - 8)
+			return fail("GLB", "TRUNCATED_BIN_CHUNK", name);
+		bin = (const unsigned char*)data + binChunk + 8;
+	}
+
+	Json root;
+	JsonParser parser(json, json + jsonLength);
+	if (!parser.parse(root) || root.type != Json::Object)
+		return fail("GLB", "BAD_JSON", name);
+
+	//Every primitive resolved and counted first, the mesh is allocated once
+	struct Primitive
+	{
+		AccessorView positions, normals, texCoords, indices;
+		bool hasNormals = false, hasTexCoords = false, indexed = false;
+		std::size_t firstVertex = 0, firstIndex = 0, indexCount = 0;
+	};
+	std::vector<Primitive> primitives;
+	std::size_t vertexCount = 0, indexCount = 0;
+	const Json* meshes = root.get("meshes");
+	for (std::size_t m = 0; meshes && m < meshes->items.size(); ++m)
+	{
+		const Json* list = meshes->items[m].get("primitives");
+		for (std::size_t p = 0; list && p < list->items.size(); ++p)
+		{
+			const Json &source = list->items[p];
+			//Points, lines and strips are left out
+			if (source.numberOr("mode", 4) != 4)
+				continue;
+			const Json* attributes = source.get("attributes");
+			if (!attributes || attributes->indexOf("POSITION") < 0)
+				return fail("GLB", "NO_POSITION", name);
+
+			Primitive primitive;
+			const char* error = resolveAccessor(root, attributes->indexOf("POSITION"), bin, binSize, primitive.positions);
+			if (!error && primitive.positions.components != 3)
+				error = "BAD_POSITION";
+			if (!error && attributes->indexOf("NORMAL") >= 0)
+			{
+				primitive.hasNormals = true;
+				error = resolveAccessor(root, attributes->indexOf("NORMAL"), bin, binSize, primitive.normals);
+				if (!error && (primitive.normals.components != 3 || primitive.normals.count != primitive.positions.count))
+					error = "BAD_NORMAL";
+			}
+			if (!error && attributes->indexOf("TEXCOORD_0") >= 0)
+			{
+				primitive.hasTexCoords = true;
+				error = resolveAccessor(root, attributes->indexOf("TEXCOORD_0"), bin, binSize, primitive.texCoords);
+				if (!error && (primitive.texCoords.components != 2 || primitive.texCoords.count != primitive.positions.count))
+					error = "BAD_TEXCOORD";
+			}
+			if (!error && source.indexOf("indices") >= 0)
+			{
+				primitive.indexed = true;
+				error = resolveAccessor(root, source.indexOf("indices"), bin, binSize, primitive.indices);
+				if (!error && (primitive.indices.components != 1 || primitive.indices.componentType == 5126))
+					error = "BAD_INDICES";
+			}
+			if (error)
+				return fail("GLB", error, name);
+
+			primitive.firstVertex = vertexCount;
+			primitive.firstIndex = indexCount;
+			primitive.indexCount = (primitive.indexed ? primitive.indices.count : primitive.positions.count) / 3 * 3;
+			//Checked before each sum, so that it can't wrap around back under the limit
+			if (primitive.positions.count >= NO_INDEX - vertexCount || primitive.indexCount >= NO_INDEX - indexCount)
+				return fail("GLB", "TOO_MANY_VERTICES", name);
+			vertexCount += primitive.positions.count;
+			indexCount += primitive.indexCount;
+			primitives.push_back(primitive);
+		}
+	}
+	if (indexCount == 0)
+		return fail("GLB", "NO_TRIANGLES", name);
+
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize(indexCount);
+	std::atomic<bool> badIndex{ false };
+	for (const Primitive &primitive : primitives)
+	{
+		parallelFor(pool, primitive.positions.count, 4096, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t v = first; v < last; ++v)
+			{
+				MeshVertex &out = mesh.vertices[primitive.firstVertex + v];
+				for (int k = 0; k < 3; ++k)
+					out.position.v[k] = primitive.positions.read(v, k);
+				if (primitive.hasNormals)
+					for (int k = 0; k < 3; ++k)
+						out.normal.v[k] = primitive.normals.read(v, k);
+				if (primitive.hasTexCoords)
+				{
+					out.texCoord.v[0] = primitive.texCoords.read(v, 0);
+					out.texCoord.v[1] = 1.0f - primitive.texCoords.read(v, 1);
+				}
+			}
+		});
+		parallelFor(pool, primitive.indexCount, 4096, [&](std::size_t first, std::size_t last)
+		{
+			for (std::size_t i = first; i < last; ++i)
+			{
+				const std::uint32_t index = primitive.indexed ? primitive.indices.readIndex(i) : (std::uint32_t)i;
+				if (index >= primitive.positions.count)
+				{
+					badIndex = true;
+					return;
+				}
+				mesh.indices[primitive.firstIndex + i] = (std::uint32_t)(primitive.firstVertex + index);
+			}
+		});
+		if (badIndex)
+			return fail("GLB", "BAD_INDEX", name);
+		if (!primitive.hasNormals)
+			computeMissingNormals(mesh, primitive.firstVertex, primitive.positions.count, primitive.firstIndex, primitive.indexCount);
+	}
+	return true;
+}
+
+bool isMeshPath(const std::string &path)
+{
+	const std::string extension = extensionOf(path);
+	return extension == ".obj" || extension == ".glb";
+}
+
+bool importMesh(const std::string &path, ImportedMesh &mesh, ThreadPool* pool)
+{
+	if (!isMeshPath(path))
+	{
+		std::cout << "ERROR::MESH::UNKNOWN_FORMAT " << path << std::endl;
+		return false;
+	}
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cout << "ERROR::MESH::FILE_NOT_SUCCESFULLY_READ " << path << " : " << file.getError() << std::endl;
+		return false;
+	}
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	if (extensionOf(path) == ".obj")
+		return importObj(file.data(), file.size(), path, mesh, pool);
+	return importGlb(file.data(), file.size(), path, mesh, pool);
+}
+
+bool writeCookedMesh(const std::string &path, const ImportedMesh &mesh)
+{
+	CookedMeshHeader header = {};
+	std::memcpy(header.magic, COOKED_MESH_MAGIC, 4);
+	header.version = COOKED_MESH_VERSION;
+	header.vertexSize = sizeof(MeshVertex);
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	const std::uint64_t alignment = COOKED_MESH_ALIGNMENT;
+	header.vertexOffset = (sizeof(header) + alignment - 1) & ~(alignment - 1);
+	header.indexOffset = (header.vertexOffset + header.vertexCount * sizeof(MeshVertex) + alignment - 1) & ~(alignment - 1);
+	for (int k = 0; k < 3; ++k)
+	{
+		header.boundsMin[k] = mesh.vertices.empty() ? 0.0f : mesh.vertices[0].position.v[k];
+		header.boundsMax[k] = header.boundsMin[k];
+	}
+	for (const MeshVertex &vertex : mesh.vertices)
+		for (int k = 0; k < 3; ++k)
+		{
+			header.boundsMin[k] = std::min(header.boundsMin[k], vertex.position.v[k]);
+			header.boundsMax[k] = std::max(header.boundsMax[k], vertex.position.v[k]);
+		}
+
+	//Written next to the cache then renamed, a running sample never maps half a file
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		const char padding[COOKED_MESH_ALIGNMENT] = {};
+		file.write((const char*)&header, sizeof(header));
+		file.write(padding, header.vertexOffset - sizeof(header));
+		file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex));
+		file.write(padding, header.indexOffset - header.vertexOffset - header.vertexCount * sizeof(MeshVertex));
+		file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t));
+		if (!file)
+			return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+bool cookMesh(const std::string &input, const std::string &output, ThreadPool* pool)
+{
+	static_assert(sizeof(unsigned int) == sizeof(std::uint32_t), "The MeshOptimizer indices are the 32 bits of the cache");
+	ImportedMesh mesh;
+	if (!importMesh(input, mesh, pool))
+		return false;
+	unsigned int* indices = mesh.indices.data();
+	const std::size_t indexCount = mesh.indices.size(), vertexCount = mesh.vertices.size();
+	optimizeVertexCache(indices, indices, indexCount, vertexCount);
+	optimizeOverdraw(indices, indices, indexCount, mesh.vertices[0].position.v, sizeof(MeshVertex), vertexCount);
+	remapVertices(mesh.vertices.data(), vertexCount, optimizeVertexFetch(indices, indexCount, vertexCount));
+	if (!writeCookedMesh(output, mesh))
+	{
+		std::cout << "ERROR::MESH::WRITE_FAILED " << output << std::endl;
+		return false;
+	}
+	return true;
+}
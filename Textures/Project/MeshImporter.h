@@ -0,0 +1,48 @@
+#pragma once
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Vertex of every imported mesh, 32 bytes
+struct MeshVertex
+{
+	vertex::vec3 position;
+	vertex::vec3 normal;
+	vertex::vec2 texCoord;
+};
+
+//One indexed triangle list, the primitives of a glTF file or the groups of an OBJ all merged
+struct ImportedMesh
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<std::uint32_t> indices;
+};
+
+//Reads meshes from a mapped file, the text or the binary buffer is parsed in place :
+//	- .obj : counted then parsed in slices of whole lines, one job per slice, straight into arrays
+//	  sized by the count. Polygons are split in fans, a position/uv/normal triple is one vertex
+//	- .glb : glTF 2.0 binary, the TRIANGLES primitives of every mesh in the file, the node transforms
+//	  are not applied. POSITION, NORMAL and TEXCOORD_0 (float, or unsigned normalized) are copied
+//	  from the binary chunk, the vertex ranges shared out between the jobs
+//The V of the UVs goes up like in GL (a glTF V is flipped). Normals missing from the file are computed
+//With a pool the parsing runs on its workers : never call it from a job of that same pool
+//Returns false, with the reason printed, on a file that can't be read
+bool importMesh(const std::string &path, ImportedMesh &mesh, ThreadPool* pool = nullptr);
+bool importObj(const char* data, std::size_t size, const std::string &name, ImportedMesh &mesh, ThreadPool* pool = nullptr);
+bool importGlb(const char* data, std::size_t size, const std::string &name, ImportedMesh &mesh, ThreadPool* pool = nullptr);
+
+//True for the extensions importMesh reads
+bool isMeshPath(const std::string &path);
+
+//Writes the mesh as it is into a .cmesh (see CookedMesh)
+bool writeCookedMesh(const std::string &path, const ImportedMesh &mesh);
+//importMesh, the three passes of the MeshOptimizer, then writeCookedMesh
+bool cookMesh(const std::string &input, const std::string &output, ThreadPool* pool = nullptr);
+
+#endif
@@ -0,0 +1,363 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+	//FIFO post-transform cache with timestamps : a vertex is in it while fewer than cacheSize
+	//vertices were shaded after it. No vertex is in it at the start
+	struct CacheSimulator
+	{
+		std::vector<unsigned int> stamp;
+		unsigned int time;
+		unsigned int cacheSize;
+
+		CacheSimulator(std::size_t vertexCount, unsigned int cacheSize)
+			: stamp(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize)
+		{
+		}
+
+		bool cached(unsigned int vertex) const
+		{
+			return time - stamp[vertex] <= cacheSize;
+		}
+		//true for a miss : the vertex is shaded and pushed into the cache
+		bool use(unsigned int vertex)
+		{
+			if (cached(vertex))
+				return false;
+			stamp[vertex] = time++;
+			return true;
+		}
+		//Pushes cacheSize vertices out : the cache is cold again
+		void flush()
+		{
+			time += cacheSize + 1;
+		}
+	};
+
+	//Triangles of each vertex, all in one array
+	struct Adjacency
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> triangles;
+
+		Adjacency(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount)
+			: offsets(vertexCount + 1, 0), triangles(indexCount)
+		{
+			for (std::size_t i = 0; i < indexCount; ++i)
+				++offsets[indices[i] + 1];
+			for (std::size_t v = 0; v < vertexCount; ++v)
+				offsets[v + 1] += offsets[v];
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (std::size_t i = 0; i < indexCount; ++i)
+				triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+		}
+	};
+
+	struct Vector3
+	{
+		double x = 0.0, y = 0.0, z = 0.0;
+	};
+
+	const float* positionOf(const float* positions, std::size_t stride, unsigned int vertex)
+	{
+		return (const float*)((const unsigned char*)positions + vertex * stride);
+	}
+
+	struct Cluster
+	{
+		std::size_t firstTriangle, triangleCount;
+		double sortKey;
+	};
+}
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	std::size_t usedCount = 0;
+	for (std::size_t i = 0; i < indexCount; ++i)
+	{
+		if (cache.use(indices[i]))
+			++stats.misses;
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			++usedCount;
+		}
+	}
+	if (indexCount >= 3)
+		stats.acmr = (float)stats.misses / (float)(indexCount / 3);
+	if (usedCount > 0)
+		stats.atvr = (float)stats.misses / (float)usedCount;
+	return stats;
+}
+
+void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+	//destination may be indices : the source is read from a copy
+	const std::vector<unsigned int> source(indices, indices + triangleCount * 3);
+	const Adjacency adjacency(source.data(), source.size(), vertexCount);
+
+	//Triangles of each vertex not emitted yet
+	std::vector<unsigned int> live(vertexCount);
+	for (std::size_t v = 0; v < vertexCount; ++v)
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	std::vector<bool> emitted(triangleCount, false);
+	CacheSimulator cache(vertexCount, cacheSize);
+	//Vertices of the last triangles, to go back to when the fan of a vertex ends nowhere
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::size_t written = 0, cursor = 0;
+
+	//Fans the triangles around one vertex, then moves to the vertex of those triangles that
+	//will still be in the cache once its own triangles are emitted
+	long long fanning = 0;
+	while (fanning >= 0)
+	{
+		const unsigned int vertex = (unsigned int)fanning;
+		candidates.clear();
+		for (unsigned int k = adjacency.offsets[vertex]; k < adjacency.offsets[vertex + 1]; ++k)
+		{
+			const unsigned int triangle = adjacency.triangles[k];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				const unsigned int v = source[triangle * 3 + corner];
+				destination[written++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				cache.use(v);
+			}
+		}
+
+		fanning = -1;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			//Age of the vertex in the cache if it stays there while its own triangles go through,
+			//0 when it will have left : the oldest one still cached is the best
+			int priority = 0;
+			const unsigned int age = cache.time - cache.stamp[v];
+			if (age + 2 * live[v] <= cacheSize)
+				priority = (int)age;
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		if (fanning >= 0)
+			continue;
+
+		//Dead end : a recent vertex with triangles left, else the next one in the buffer
+		while (!deadEnd.empty() && fanning < 0)
+		{
+			const unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+				fanning = v;
+		}
+		while (fanning < 0 && cursor < vertexCount)
+		{
+			if (live[cursor] > 0)
+				fanning = (long long)cursor;
+			++cursor;
+		}
+	}
+}
+
+void optimizeOverdraw(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride, std::size_t vertexCount, float threshold, unsigned int cacheSize)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+	const std::vector<unsigned int> source(indices, indices + triangleCount * 3);
+
+	//Hard boundaries : the triangle misses its 3 vertices, the cache holds nothing of the previous ones
+	std::vector<std::size_t> hard;
+	{
+		CacheSimulator cache(vertexCount, cacheSize);
+		for (std::size_t t = 0; t < triangleCount; ++t)
+		{
+			int misses = 0;
+			for (int corner = 0; corner < 3; ++corner)
+				misses += cache.use(source[t * 3 + corner]) ? 1 : 0;
+			if (t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triangleCount);
+	}
+
+	//Soft boundaries : a cluster is cut where the part before the cut, from a cold cache,
+	//is already within threshold of the ACMR of the whole cluster
+	std::vector<Cluster> clusters;
+	CacheSimulator cache(vertexCount, cacheSize);
+	for (std::size_t h = 0; h + 1 < hard.size(); ++h)
+	{
+		const std::size_t first = hard[h], end = hard[h + 1];
+		cache.flush();
+		unsigned int clusterMisses = 0;
+		for (std::size_t i = first * 3; i < end * 3; ++i)
+			clusterMisses += cache.use(source[i]) ? 1 : 0;
+		const double limit = threshold * (double)clusterMisses / (double)(end - first);
+
+		cache.flush();
+		std::size_t start = first;
+		unsigned int misses = 0;
+		for (std::size_t t = first; t < end; ++t)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+				misses += cache.use(source[t * 3 + corner]) ? 1 : 0;
+			if (t + 1 < end && (double)misses / (double)(t + 1 - start) <= limit)
+			{
+				clusters.push_back({ start, t + 1 - start, 0.0 });
+				start = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+		clusters.push_back({ start, end - start, 0.0 });
+	}
+
+	//Center of the mesh, weighted by the area of the triangles
+	Vector3 meshCenter;
+	double meshArea = 0.0;
+	std::vector<Vector3> centers(clusters.size()), normals(clusters.size());
+	for (std::size_t c = 0; c < clusters.size(); ++c)
+	{
+		double clusterArea = 0.0;
+		for (std::size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; ++t)
+		{
+			const float* a = positionOf(positions, positionStride, source[t * 3]);
+			const float* b = positionOf(positions, positionStride, source[t * 3 + 1]);
+			const float* d = positionOf(positions, positionStride, source[t * 3 + 2]);
+			const double ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+			const double vx = d[0] - a[0], vy = d[1] - a[1], vz = d[2] - a[2];
+			//Twice the area, pointing outwards for counter clockwise triangles
+			const double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+			const double area = std::sqrt(nx * nx + ny * ny + nz * nz);
+			normals[c].x += nx;
+			normals[c].y += ny;
+			normals[c].z += nz;
+			centers[c].x += area * (a[0] + b[0] + d[0]) / 3.0;
+			centers[c].y += area * (a[1] + b[1] + d[1]) / 3.0;
+			centers[c].z += area * (a[2] + b[2] + d[2]) / 3.0;
+			clusterArea += area;
+		}
+		meshCenter.x += centers[c].x;
+		meshCenter.y += centers[c].y;
+		meshCenter.z += centers[c].z;
+		meshArea += clusterArea;
+		if (clusterArea > 0.0)
+		{
+			centers[c].x /= clusterArea;
+			centers[c].y /= clusterArea;
+			centers[c].z /= clusterArea;
+		}
+	}
+	if (meshArea > 0.0)
+	{
+		meshCenter.x /= meshArea;
+		meshCenter.y /= meshArea;
+		meshCenter.z /= meshArea;
+	}
+
+	//The farther a cluster is from the center in the direction it faces, the more it occludes
+	for (std::size_t c = 0; c < clusters.size(); ++c)
+	{
+		const Vector3 &n = normals[c];
+		const double length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (length > 0.0)
+			clusters[c].sortKey = ((centers[c].x - meshCenter.x) * n.x + (centers[c].y - meshCenter.y) * n.y + (centers[c].z - meshCenter.z) * n.z) / length;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+	std::size_t written = 0;
+	for (const Cluster &cluster : clusters)
+		for (std::size_t i = cluster.firstTriangle * 3; i < (cluster.firstTriangle + cluster.triangleCount) * 3; ++i)
+			destination[written++] = source[i];
+}
+
+std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	unsigned int next = 0;
+	for (std::size_t i = 0; i < indexCount; ++i)
+	{
+		unsigned int &target = remap[indices[i]];
+		if (target == unused)
+			target = next++;
+		indices[i] = target;
+	}
+	for (unsigned int &target : remap)
+		if (target == unused)
+			target = next++;
+	return remap;
+}
+
+void benchmarkMeshOptimizer(const char* name, const std::vector<unsigned int> &indices, const std::vector<float> &positions, std::ostream &out)
+{
+	const unsigned int cacheSizes[] = { 16, 32 };
+	const std::size_t vertexCount = positions.size() / 3;
+	out << "Mesh " << name << " : " << indices.size() / 3 << " triangles, " << vertexCount << " vertices" << std::endl;
+
+	//Bytes read from memory per byte of vertex buffer, for 32 bytes vertices : the vertices shaded
+	//are read through 64 bytes lines kept in a 4 KB cache, 1 is every line read once
+	const std::size_t vertexSize = 32, lineSize = 64;
+	auto overfetch = [&](const std::vector<unsigned int> &order)
+	{
+		CacheSimulator cache(vertexCount, cacheSizes[0]);
+		CacheSimulator lines(vertexCount * vertexSize / lineSize + 1, 4096 / lineSize);
+		std::size_t lineFetches = 0;
+		for (unsigned int vertex : order)
+			if (cache.use(vertex) && lines.use((unsigned int)(vertex * vertexSize / lineSize)))
+				++lineFetches;
+		return vertexCount > 0 ? (double)(lineFetches * lineSize) / (double)(vertexCount * vertexSize) : 0.0;
+	};
+	auto report = [&](const char* step, const std::vector<unsigned int> &order, double milliseconds)
+	{
+		out << "\t" << step;
+		for (unsigned int cacheSize : cacheSizes)
+		{
+			const VertexCacheStats stats = analyzeVertexCache(order.data(), order.size(), vertexCount, cacheSize);
+			out << "\tcache " << cacheSize << " acmr " << stats.acmr << " atvr " << stats.atvr;
+		}
+		out << "\toverfetch " << overfetch(order);
+		if (milliseconds > 0.0)
+			out << "\t" << milliseconds << " ms";
+		out << std::endl;
+	};
+	auto elapsed = [](std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	std::vector<unsigned int> order = indices;
+	report("input       ", order, 0.0);
+
+	auto start = std::chrono::steady_clock::now();
+	optimizeVertexCache(order.data(), order.data(), order.size(), vertexCount);
+	report("vertex cache", order, elapsed(start));
+
+	start = std::chrono::steady_clock::now();
+	optimizeOverdraw(order.data(), order.data(), order.size(), positions.data(), 3 * sizeof(float), vertexCount);
+	report("overdraw    ", order, elapsed(start));
+
+	start = std::chrono::steady_clock::now();
+	optimizeVertexFetch(order.data(), order.size(), vertexCount);
+	report("vertex fetch", order, elapsed(start));
+}
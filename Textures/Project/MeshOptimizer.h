@@ -0,0 +1,53 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+//Reorders indexed triangle lists before they are uploaded, the triangles and the vertices stay the same :
+//	1. optimizeVertexCache : Tipsify (Sander, Nehab, Barczak 2007), linear time, so that the vertices
+//	   shaded for a triangle are still in the post-transform cache for the next ones
+//	2. optimizeOverdraw : cuts that order into clusters where the cache is cold anyway, and draws
+//	   the clusters facing outwards first, they hide the others whatever the view
+//	3. optimizeVertexFetch : numbers the vertices in the order the indices first use them,
+//	   the vertex fetches then walk the vertex buffer forward
+//Triangle lists only, every index below vertexCount
+
+//Cost of an index order for a FIFO post-transform cache
+struct VertexCacheStats
+{
+	//Vertices shaded per triangle : 3 at worst, 0.5 at best for a large regular grid
+	float acmr = 0.0f;
+	//Vertices shaded per vertex of the mesh : 1 is every vertex shaded once
+	float atvr = 0.0f;
+	unsigned int misses = 0;
+};
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = 16);
+
+//destination may be indices
+void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = 16);
+//indices : already in vertex cache order
+//positions : 3 floats per vertex, positionStride bytes apart
+//threshold : how much worse the ACMR of a cluster may get in exchange for smaller clusters (1.05 : 5%)
+void optimizeOverdraw(unsigned int* destination, const unsigned int* indices, std::size_t indexCount, const float* positions, std::size_t positionStride, std::size_t vertexCount, float threshold = 1.05f, unsigned int cacheSize = 16);
+//Renumbers the indices in place, returns remap[old vertex] = new vertex
+//Vertices no index uses go after the others
+std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount);
+
+//Moves each vertex to its new place after optimizeVertexFetch
+template<typename Vertex>
+void remapVertices(Vertex* vertices, std::size_t vertexCount, const std::vector<unsigned int> &remap)
+{
+	const std::vector<Vertex> copy(vertices, vertices + vertexCount);
+	for (std::size_t i = 0; i < vertexCount; ++i)
+		vertices[remap[i]] = copy[i];
+}
+
+//Runs the three passes on a copy of the mesh and prints the ACMR and the ATVR of each step
+//for several cache sizes, and the time they took
+void benchmarkMeshOptimizer(const char* name, const std::vector<unsigned int> &indices, const std::vector<float> &positions, std::ostream &out);
+
+#endif
@@ -0,0 +1,482 @@
+#include "MipGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+//MSVC accepts the intrinsics of any instruction set in any function
+#define MIP_SSE2_TARGET
+#define MIP_AVX2_TARGET
+#else
+#include <cpuid.h>
+//GCC and clang only emit them in functions compiled for that target
+#define MIP_SSE2_TARGET __attribute__((target("sse2")))
+#define MIP_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	//Linear floats are encoded back to 8 bits through tables of encodeSteps + 1 entries
+	const int encodeSteps = 16383;
+	const int kaiserTaps = 8;
+
+	double besselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	struct Tables
+	{
+		float srgbToLinear[256];
+		float unormToFloat[256];
+		unsigned char linearToSrgb[encodeSteps + 1];
+		unsigned char floatToUnorm[encodeSteps + 1];
+		//Weight of the source texels 2x-3 to 2x+4 for the destination texel x
+		float kaiser[kaiserTaps];
+
+		Tables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				const double s = i / 255.0;
+				srgbToLinear[i] = (float)(s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4));
+				unormToFloat[i] = (float)s;
+			}
+			for (int i = 0; i <= encodeSteps; ++i)
+			{
+				const double l = (double)i / encodeSteps;
+				const double s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+				linearToSrgb[i] = (unsigned char)(s * 255.0 + 0.5);
+				floatToUnorm[i] = (unsigned char)(l * 255.0 + 0.5);
+			}
+			//sinc for a factor 2 reduction, windowed by a Kaiser window (alpha 4) over 4 destination texels
+			const double pi = 3.14159265358979323846;
+			const double alpha = 4.0, radius = kaiserTaps / 2;
+			double sum = 0.0;
+			double weights[kaiserTaps];
+			for (int t = 0; t < kaiserTaps; ++t)
+			{
+				//Distance between the center of the source texel and the one of the destination texel
+				const double d = t - radius + 0.5;
+				const double x = d / 2.0;
+				const double sinc = std::sin(pi * x) / (pi * x);
+				const double window = besselI0(alpha * std::sqrt(1.0 - (d / radius) * (d / radius))) / besselI0(alpha);
+				weights[t] = sinc * window;
+				sum += weights[t];
+			}
+			for (int t = 0; t < kaiserTaps; ++t)
+				kaiser[t] = (float)(weights[t] / sum);
+		}
+	};
+
+	const Tables& tables()
+	{
+		static const Tables instance;
+		return instance;
+	}
+
+	//4 floats per texel whatever the channel count, so that one texel is one SSE register
+	struct Image
+	{
+		int width = 0, height = 0;
+		std::vector<float> texels;
+
+		void resize(int w, int h)
+		{
+			width = w;
+			height = h;
+			texels.assign((std::size_t)w * h * 4, 0.0f);
+		}
+		float* row(int y) { return texels.data() + (std::size_t)y * width * 4; }
+		const float* row(int y) const { return texels.data() + (std::size_t)y * width * 4; }
+	};
+
+	typedef void(*BoxRowFunction)(const float* row0, const float* row1, float* out, int width);
+	typedef void(*KaiserRowFunction)(const float* padded, float* out, int width);
+	typedef void(*WeightedSumFunction)(const float* const* rows, float* out, int count);
+	typedef void(*EncodeFunction)(const float* texels, unsigned char* out, int count, int channels, const unsigned char* const* encode);
+
+	struct Kernels
+	{
+		BoxRowFunction boxRow;
+		KaiserRowFunction kaiserRow;
+		WeightedSumFunction weightedSum;
+		EncodeFunction encode;
+	};
+
+	//Every kernel adds in the same order as the scalar one : all of them give the same bytes
+
+	//out[x] = average of the texels 2x and 2x+1 of both rows
+	void boxRowScalar(const float* row0, const float* row1, float* out, int width)
+	{
+		for (int x = 0; x < width; ++x)
+			for (int c = 0; c < 4; ++c)
+				out[x * 4 + c] = (((row0[x * 8 + c] + row0[x * 8 + 4 + c]) + row1[x * 8 + c]) + row1[x * 8 + 4 + c]) * 0.25f;
+	}
+
+	//padded holds the source row with 3 clamped texels before it and 4 after it
+	void kaiserRowScalar(const float* padded, float* out, int width)
+	{
+		const float* weights = tables().kaiser;
+		for (int x = 0; x < width; ++x)
+			for (int c = 0; c < 4; ++c)
+			{
+				float sum = 0.0f;
+				for (int t = 0; t < kaiserTaps; ++t)
+					sum += weights[t] * padded[(x * 2 + t) * 4 + c];
+				out[x * 4 + c] = sum;
+			}
+	}
+
+	void weightedSumScalar(const float* const* rows, float* out, int count)
+	{
+		const float* weights = tables().kaiser;
+		for (int i = 0; i < count; ++i)
+		{
+			float sum = 0.0f;
+			for (int t = 0; t < kaiserTaps; ++t)
+				sum += weights[t] * rows[t][i];
+			out[i] = sum;
+		}
+	}
+
+	int encodeIndex(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return (int)(value * encodeSteps + 0.5f);
+	}
+
+	void encodeScalar(const float* texels, unsigned char* out, int count, int channels, const unsigned char* const* encode)
+	{
+		for (int i = 0; i < count; ++i)
+			for (int c = 0; c < channels; ++c)
+				out[i * channels + c] = encode[c][encodeIndex(texels[i * 4 + c])];
+	}
+
+#ifdef MIP_X86
+	MIP_SSE2_TARGET void boxRowSSE2(const float* row0, const float* row1, float* out, int width)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (int x = 0; x < width; ++x)
+		{
+			__m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row0 + x * 8 + 4));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(row1 + x * 8));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(row1 + x * 8 + 4));
+			_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, quarter));
+		}
+	}
+
+	MIP_SSE2_TARGET void kaiserRowSSE2(const float* padded, float* out, int width)
+	{
+		const float* weights = tables().kaiser;
+		for (int x = 0; x < width; ++x)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < kaiserTaps; ++t)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(padded + (x * 2 + t) * 4)));
+			_mm_storeu_ps(out + x * 4, sum);
+		}
+	}
+
+	MIP_SSE2_TARGET void weightedSumSSE2(const float* const* rows, float* out, int count)
+	{
+		const float* weights = tables().kaiser;
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < kaiserTaps; ++t)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+			_mm_storeu_ps(out + i, sum);
+		}
+		const float* tail[kaiserTaps];
+		for (int t = 0; t < kaiserTaps; ++t)
+			tail[t] = rows[t] + i;
+		weightedSumScalar(tail, out + i, count - i);
+	}
+
+	//The indices are computed 4 channels at a time, only the table reads stay scalar
+	MIP_SSE2_TARGET void encodeSSE2(const float* texels, unsigned char* out, int count, int channels, const unsigned char* const* encode)
+	{
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 steps = _mm_set1_ps((float)encodeSteps), half = _mm_set1_ps(0.5f);
+		alignas(16) int index[4];
+		for (int i = 0; i < count; ++i)
+		{
+			const __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(texels + i * 4), zero), one);
+			_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, steps), half)));
+			for (int c = 0; c < channels; ++c)
+				out[i * channels + c] = encode[c][index[c]];
+		}
+	}
+
+	//Two texels per register : the low half is the texel x, the high half the texel x+1
+	MIP_AVX2_TARGET void boxRowAVX2(const float* row0, const float* row1, float* out, int width)
+	{
+		const __m256 quarter = _mm256_set1_ps(0.25f);
+		int x = 0;
+		for (; x + 2 <= width; x += 2)
+		{
+			const __m256 a0 = _mm256_loadu_ps(row0 + x * 8), b0 = _mm256_loadu_ps(row0 + x * 8 + 8);
+			const __m256 a1 = _mm256_loadu_ps(row1 + x * 8), b1 = _mm256_loadu_ps(row1 + x * 8 + 8);
+			//Even texels of the pair in one register, odd ones in the other
+			__m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20), _mm256_permute2f128_ps(a0, b0, 0x31));
+			sum = _mm256_add_ps(sum, _mm256_permute2f128_ps(a1, b1, 0x20));
+			sum = _mm256_add_ps(sum, _mm256_permute2f128_ps(a1, b1, 0x31));
+			_mm256_storeu_ps(out + x * 4, _mm256_mul_ps(sum, quarter));
+		}
+		boxRowSSE2(row0 + x * 8, row1 + x * 8, out + x * 4, width - x);
+	}
+
+	MIP_AVX2_TARGET void kaiserRowAVX2(const float* padded, float* out, int width)
+	{
+		const float* weights = tables().kaiser;
+		int x = 0;
+		for (; x + 2 <= width; x += 2)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int t = 0; t < kaiserTaps; ++t)
+			{
+				const float* texel = padded + (x * 2 + t) * 4;
+				const __m256 pair = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(texel)), _mm_loadu_ps(texel + 8), 1);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[t]), pair));
+			}
+			_mm256_storeu_ps(out + x * 4, sum);
+		}
+		kaiserRowSSE2(padded + x * 8, out + x * 4, width - x);
+	}
+
+	MIP_AVX2_TARGET void weightedSumAVX2(const float* const* rows, float* out, int count)
+	{
+		const float* weights = tables().kaiser;
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int t = 0; t < kaiserTaps; ++t)
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i)));
+			_mm256_storeu_ps(out + i, sum);
+		}
+		const float* tail[kaiserTaps];
+		for (int t = 0; t < kaiserTaps; ++t)
+			tail[t] = rows[t] + i;
+		weightedSumSSE2(tail, out + i, count - i);
+	}
+
+	bool cpuHasAVX2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		//The OS must also save the AVX registers
+		const bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return osSavesAVX && (info[1] & (1 << 5));
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	bool cpuHasSSE2()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+#endif
+
+	Kernels kernelsFor(MipKernel kernel)
+	{
+		const MipKernel best = bestMipKernel();
+		if (kernel == MipKernel::Auto || kernel > best)
+			kernel = best;
+		switch (kernel)
+		{
+#ifdef MIP_X86
+		case MipKernel::AVX2: return { boxRowAVX2, kaiserRowAVX2, weightedSumAVX2, encodeSSE2 };
+		case MipKernel::SSE2: return { boxRowSSE2, kaiserRowSSE2, weightedSumSSE2, encodeSSE2 };
+#endif
+		default: return { boxRowScalar, kaiserRowScalar, weightedSumScalar, encodeScalar };
+		}
+	}
+
+	//Box filter when a side is already 1 texel : the last row / column is repeated
+	void boxClamped(const Image &source, Image &destination)
+	{
+		for (int y = 0; y < destination.height; ++y)
+		{
+			const float* row0 = source.row(std::min(y * 2, source.height - 1));
+			const float* row1 = source.row(std::min(y * 2 + 1, source.height - 1));
+			for (int x = 0; x < destination.width; ++x)
+			{
+				const int x0 = std::min(x * 2, source.width - 1) * 4;
+				const int x1 = std::min(x * 2 + 1, source.width - 1) * 4;
+				for (int c = 0; c < 4; ++c)
+					destination.row(y)[x * 4 + c] = (((row0[x0 + c] + row0[x1 + c]) + row1[x0 + c]) + row1[x1 + c]) * 0.25f;
+			}
+		}
+	}
+
+	void downsample(const Image &source, Image &destination, MipFilter filter, const Kernels &kernels)
+	{
+		//Odd sizes are rounded down like the GL does, the last row / column only counts for the Kaiser filter
+		destination.resize(std::max(1, source.width / 2), std::max(1, source.height / 2));
+		if (filter == MipFilter::Box)
+		{
+			if (source.width < 2 || source.height < 2)
+				boxClamped(source, destination);
+			else
+				for (int y = 0; y < destination.height; ++y)
+					kernels.boxRow(source.row(y * 2), source.row(y * 2 + 1), destination.row(y), destination.width);
+			return;
+		}
+
+		//Separable : horizontal pass into an image of the destination width, then vertical pass
+		Image horizontal;
+		horizontal.resize(destination.width, source.height);
+		std::vector<float> padded(((std::size_t)source.width + kaiserTaps - 1) * 4);
+		for (int y = 0; y < source.height; ++y)
+		{
+			const float* row = source.row(y);
+			for (int p = 0; p < source.width + kaiserTaps - 1; ++p)
+			{
+				const int x = std::min(std::max(p - (kaiserTaps / 2 - 1), 0), source.width - 1);
+				std::copy(row + x * 4, row + x * 4 + 4, padded.begin() + p * 4);
+			}
+			kernels.kaiserRow(padded.data(), horizontal.row(y), destination.width);
+		}
+		const float* rows[kaiserTaps];
+		for (int y = 0; y < destination.height; ++y)
+		{
+			for (int t = 0; t < kaiserTaps; ++t)
+				rows[t] = horizontal.row(std::min(std::max(y * 2 + t - (kaiserTaps / 2 - 1), 0), source.height - 1));
+			kernels.weightedSum(rows, destination.row(y), destination.width * 4);
+		}
+	}
+
+	//Alpha is the last channel of the 2 and 4 channels images
+	bool isColorChannel(int channel, int channels)
+	{
+		return !((channels == 2 || channels == 4) && channel == channels - 1);
+	}
+
+	std::vector<MipLevel> buildWith(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, bool srgb, const Kernels &kernels)
+	{
+		const Tables &table = tables();
+		const float* decode[4];
+		const unsigned char* encode[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			const bool gamma = srgb && isColorChannel(c, channels);
+			decode[c] = gamma ? table.srgbToLinear : table.unormToFloat;
+			encode[c] = gamma ? table.linearToSrgb : table.floatToUnorm;
+		}
+
+		Image image;
+		image.resize(width, height);
+		const std::size_t count = (std::size_t)width * height;
+		for (std::size_t i = 0; i < count; ++i)
+			for (int c = 0; c < channels; ++c)
+				image.texels[i * 4 + c] = decode[c][pixels[i * channels + c]];
+
+		std::vector<MipLevel> levels;
+		Image next;
+		while (image.width > 1 || image.height > 1)
+		{
+			downsample(image, next, filter, kernels);
+			std::swap(image, next);
+			MipLevel level;
+			level.width = image.width;
+			level.height = image.height;
+			level.pixels.resize((std::size_t)image.width * image.height * channels);
+			kernels.encode(image.texels.data(), level.pixels.data(), image.width * image.height, channels, encode);
+			levels.push_back(std::move(level));
+		}
+		return levels;
+	}
+}
+
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions &options)
+{
+	if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4)
+		return std::vector<MipLevel>();
+	return buildWith(pixels, width, height, channels, options.filter, options.srgb, kernelsFor(options.kernel));
+}
+
+MipKernel bestMipKernel()
+{
+#ifdef MIP_X86
+	static const MipKernel best = cpuHasAVX2() ? MipKernel::AVX2 : cpuHasSSE2() ? MipKernel::SSE2 : MipKernel::Scalar;
+	return best;
+#else
+	return MipKernel::Scalar;
+#endif
+}
+
+const char* mipKernelName(MipKernel kernel)
+{
+	switch (kernel)
+	{
+	case MipKernel::Scalar: return "scalar";
+	case MipKernel::SSE2: return "sse2";
+	case MipKernel::AVX2: return "avx2";
+	default: return "auto";
+	}
+}
+
+void benchmarkMipChain(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, int iterations, std::ostream &out)
+{
+	const MipKernel kernels[] = { MipKernel::Scalar, MipKernel::SSE2, MipKernel::AVX2 };
+	iterations = std::max(1, iterations);
+	out << "Mip chain " << width << "x" << height << "x" << channels << (filter == MipFilter::Box ? " box" : " kaiser") << std::endl;
+
+	std::vector<MipLevel> reference;
+	double scalarTime = 0.0;
+	for (MipKernel kernel : kernels)
+	{
+		if (kernel > bestMipKernel())
+			break;
+		MipOptions options;
+		options.filter = filter;
+		options.kernel = kernel;
+		std::vector<MipLevel> levels;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+			levels = buildMipChain(pixels, width, height, channels, options);
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		if (kernel == MipKernel::Scalar)
+		{
+			reference = levels;
+			scalarTime = time;
+		}
+		int difference = 0;
+		for (std::size_t level = 0; level < levels.size() && level < reference.size(); ++level)
+			for (std::size_t i = 0; i < levels[level].pixels.size(); ++i)
+				difference = std::max(difference, std::abs(levels[level].pixels[i] - reference[level].pixels[i]));
+
+		out << "\t" << mipKernelName(kernel) << "\t" << time << " ms\tx" << scalarTime / time << "\tmax difference " << difference << std::endl;
+	}
+}
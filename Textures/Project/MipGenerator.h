@@ -0,0 +1,56 @@
+#pragma once
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <ostream>
+#include <vector>
+
+//Mip chain built on the CPU instead of glGenerateMipmap
+//	- the 8 bits images of stbi_load (1 to 4 channels) are converted to linear floats once,
+//	  sRGB color channels through a table (alpha and non color data stay linear)
+//	- every level is filtered from the float copy of the previous one, then encoded back to 8 bits
+//	- the filters run with SSE2 or AVX2 when the CPU has them, the scalar path gives the same bytes
+enum class MipFilter
+{
+	//2x2 average, like glGenerateMipmap
+	Box,
+	//8x8 separable windowed sinc, sharper distant textures
+	Kaiser
+};
+
+enum class MipKernel
+{
+	//Best one the CPU supports
+	Auto,
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+struct MipOptions
+{
+	MipFilter filter = MipFilter::Box;
+	//The color channels are sRGB encoded : they are averaged in linear space
+	bool srgb = true;
+	MipKernel kernel = MipKernel::Auto;
+};
+
+struct MipLevel
+{
+	int width, height;
+	std::vector<unsigned char> pixels;
+};
+
+//Levels 1 down to 1x1 of the image, level 0 is not copied
+//Each level is tightly packed with the channel count of the image
+std::vector<MipLevel> buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions &options = MipOptions());
+
+//The kernel Auto stands for on this CPU
+MipKernel bestMipKernel();
+const char* mipKernelName(MipKernel kernel);
+
+//Builds the chain `iterations` times with every kernel the CPU supports and prints
+//the time per chain, the speedup over the scalar kernel and the largest difference with its bytes
+void benchmarkMipChain(const unsigned char* pixels, int width, int height, int channels, MipFilter filter, int iterations, std::ostream &out);
+
+#endif
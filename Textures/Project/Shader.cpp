@@ -1,99 +1,535 @@
 #include "Shader.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+std::string Shader::binaryCacheDirectory = "shader_cache";
+ShaderPreprocessor Shader::preprocessor;
+
+namespace
+{
+	//Header written in front of the driver blob in each cache file
+	struct ProgramBinaryHeader
+	{
+		std::uint32_t magic;
+		std::uint32_t format;
+		std::uint64_t key;
+		std::uint32_t length;
+	};
+	const std::uint32_t PROGRAM_BINARY_MAGIC = 0x4E494253; //"SBIN"
+}
+
+//Only declared by loaders generated with GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, BuildMode mode)
+	: Shader(vertexPath, fragmentPath, {}, mode)
+{
+}
+
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string> &defines, BuildMode mode)
+	: vertexFile(vertexPath), fragmentFile(fragmentPath), defines(defines)
+{
+	build(mode, nullptr, nullptr);
+}
+
+Shader::Shader(const EmbeddedShader &vertex, const EmbeddedShader &fragment, BuildMode mode)
+	: Shader(vertex, fragment, {}, mode)
+{
+}
+
+Shader::Shader(const EmbeddedShader &vertex, const EmbeddedShader &fragment, const std::vector<std::string> &defines, BuildMode mode)
+	: vertexFile(vertex.path), fragmentFile(fragment.path), defines(defines)
+{
+	//Registered under their file names, the preprocessor then never looks for them on disk
+	preprocessor.addEmbedded(vertex.path, vertex.code, vertex.hash);
+	preprocessor.addEmbedded(fragment.path, fragment.code, fragment.hash);
+	build(mode, &vertex, &fragment);
+}
+
+namespace
+{
+	//The hash of an embedded file is only valid while its source goes to the driver unchanged
+	std::uint64_t sourceHash(const ShaderSource &source, const EmbeddedShader* embedded)
+	{
+		const bool unchanged = embedded && source.defines.empty() && source.tail.empty()
+			&& source.head.data() == embedded->code.data() && source.head.size() == embedded->code.size();
+		return unchanged ? embedded->hash : source.hash();
+	}
+}
+
+void Shader::build(BuildMode mode, const EmbeddedShader* vertex, const EmbeddedShader* fragment)
 {
 	//1 -- Retrieve the vertex/fragment source code from filePath
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	//ensure istream objects can throw exceptions
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
-	{
-		//open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		//Read file's buffer into streams
-		//If rdbud -> return null the function set the badbit error state flag
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		//Close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		//convert stream into string;
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e)
-	{
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-	}
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
-
-	//2--Compile Shaders
-	unsigned int vertex, fragment;
+	//The preprocessor resolves the #include, adds the defines and caches what it read
+	//The sources are memory mapped and given to the driver in place
+	ShaderSource vertexSource, fragmentSource;
+	if (!preprocessor.variant(vertexFile, defines, vertexSource) || !preprocessor.variant(fragmentFile, defines, fragmentSource))
+	{
+		preprocessor.release();
+		//Nothing to compile : the program stays 0 instead of being built from an empty source
+		ID = 0;
+		status = Status::Failed;
+		return;
+	}
+
+	//2--Hand the sources to the driver, only wait for the result in blocking mode
+	submit(vertexSource, fragmentSource, sourceHash(vertexSource, vertex), sourceHash(fragmentSource, fragment));
+	//glShaderSource has copied them, the files can be saved again
+	preprocessor.release();
+	if (mode == BuildMode::Blocking)
+		finishBuild();
+}
+
+void Shader::submit(const ShaderSource &vertexSource, const ShaderSource &fragmentSource, std::uint64_t vertexHash, std::uint64_t fragmentHash)
+{
+	//Reuse the program linked by a previous run if the driver accepts it
+	cacheKey = programCacheKey(vertexHash, fragmentHash);
+	if (loadProgramBinary(cacheKey))
+	{
+		buildReflection();
+		status = Status::Ready;
+		return;
+	}
+
+	//Compile Shaders
+	//No status query here : it would make us wait for the compiler, it is done in finishBuild()
+	vertexStage = glCreateShader(GL_VERTEX_SHADER);
+	vertexSource.upload(vertexStage);
+	glCompileShader(vertexStage);
+
+	fragmentStage = glCreateShader(GL_FRAGMENT_SHADER);
+	fragmentSource.upload(fragmentStage);
+	glCompileShader(fragmentStage);
+
+	ID = glCreateProgram();
+	//Ask the driver to keep the binary around so that we can store it
+	if (programBinarySupported())
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(ID, vertexStage);
+	glAttachShader(ID, fragmentStage);
+	glLinkProgram(ID);
+	status = Status::Pending;
+}
+
+Shader::Status Shader::poll()
+{
+	if (status != Status::Pending)
+		return status;
+
+	//Without GL_KHR_parallel_shader_compile there is no way to ask without waiting
+	if (parallelCompileSupported())
+	{
+		int completed = GL_FALSE;
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed)
+			return status;
+	}
+	finishBuild();
+	return status;
+}
+
+Shader::Status Shader::getStatus() const
+{
+	return status;
+}
+
+void Shader::finishBuild()
+{
+	if (status != Status::Pending)
+		return;
+
 	int success;
 	char infoLog[512];
 
-	//vertexShader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
 	//print errors compile if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(vertexStage, GL_COMPILE_STATUS, &success);
 	if(!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(vertexStage, 512, NULL, infoLog);
 		std::cout << "ERROR::VERTEX::SHADER::COMPILATION::FAILED\n" << infoLog << "\n";
 	}
-
-	//fragment shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(fragmentStage, GL_COMPILE_STATUS, &success);
 	if(!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(fragmentStage, 512, NULL, infoLog);
 		std::cout << "ERROR::FRAGMENT::SHADER::COMPILATION::FAILED\n" << infoLog << "\n";
 	}
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
 	if(!success)
 	{
 		glGetProgramInfoLog(ID, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		status = Status::Failed;
+	}
+	else
+	{
+		buildReflection();
+		saveProgramBinary(cacheKey);
+		status = Status::Ready;
+	}
+
+	glDeleteShader(vertexStage);
+	glDeleteShader(fragmentStage);
+	vertexStage = 0;
+	fragmentStage = 0;
+}
+
+bool Shader::parallelCompileSupported()
+{
+	return hasGLExtension("GL_KHR_parallel_shader_compile");
+}
+
+bool Shader::programBinarySupported()
+{
+	//GL 4.1 or ARB_get_program_binary, without it the query fails and leaves 0
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+std::uint64_t Shader::programCacheKey(std::uint64_t vertexHash, std::uint64_t fragmentHash)
+{
+	//A binary is only valid for the exact driver that produced it
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	std::uint64_t key = hashSource(std::string_view((const char*)&vertexHash, sizeof(vertexHash)));
+	key = hashSource(std::string_view((const char*)&fragmentHash, sizeof(fragmentHash)), key);
+	key = hashSource(vendor ? vendor : "", key);
+	key = hashSource(std::string_view("\0", 1), key);
+	key = hashSource(renderer ? renderer : "", key);
+	key = hashSource(std::string_view("\0", 1), key);
+	key = hashSource(version ? version : "", key);
+	return key;
+}
+
+std::string Shader::programCachePath(std::uint64_t key)
+{
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)key);
+	return (std::filesystem::path(binaryCacheDirectory) / fileName).string();
+}
+
+bool Shader::loadProgramBinary(std::uint64_t key)
+{
+	ID = 0;
+	if (binaryCacheDirectory.empty() || !programBinarySupported())
+		return false;
+
+	const std::string path = programCachePath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	ProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC || header.key != key)
+		return false;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return false;
+	file.close();
+
+	ID = glCreateProgram();
+	glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glProgramBinary(ID, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+
+	//The driver may reject a binary (driver update, other GPU...) -> silently rebuild from source
+	int success = 0;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(ID);
+		ID = 0;
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return false;
 	}
+	return true;
+}
+
+void Shader::saveProgramBinary(std::uint64_t key)const
+{
+	if (binaryCacheDirectory.empty() || !programBinarySupported())
+		return;
 
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	GLint length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramBinaryHeader header;
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.key = key;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(ID, length, &length, &format, binary.data());
+	header.format = format;
+	header.length = (std::uint32_t)length;
+
+	std::error_code error;
+	std::filesystem::create_directories(binaryCacheDirectory, error);
+
+	//Write to a temporary file first so that a crash never leaves a truncated binary behind
+	const std::string path = programCachePath(key);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), length);
+		if (!file)
+			return;
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
 }
 
 void Shader::use() const
 {
-	glUseProgram(ID);
+	GLStateCache::get().useProgram(ID);
+}
+
+void Shader::buildReflection()
+{
+	uniforms.clear();
+	uniformBlocks.clear();
+	attributes.clear();
+
+	int count = 0;
+	int maxLength = 0;
+	std::vector<char> name;
+
+	//Uniforms
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	name.resize(maxLength > 0 ? maxLength : 1);
+	for (int i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		//Uniforms inside a block have no location, they are set through the buffer
+		int location = glGetUniformLocation(ID, name.data());
+		if (location < 0)
+			continue;
+
+		std::string_view uniformName(name.data(), length);
+		addVariable(uniforms, uniformName, location, type, size);
+		//Arrays are reported as "name[0]" -> also register "name" and the other elements
+		if (uniformName.size() > 3 && uniformName.substr(uniformName.size() - 3) == "[0]")
+		{
+			std::string_view baseName = uniformName.substr(0, uniformName.size() - 3);
+			addVariable(uniforms, baseName, location, type, size);
+			for (int element = 1; element < size; ++element)
+			{
+				std::string elementName = std::string(baseName) + "[" + std::to_string(element) + "]";
+				int elementLocation = glGetUniformLocation(ID, elementName.c_str());
+				if (elementLocation >= 0)
+					addVariable(uniforms, elementName, elementLocation, type, 1);
+			}
+		}
+	}
+
+	//Uniform blocks
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength > 0 ? maxLength : 1);
+	for (int i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint dataSize = 0;
+		glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)name.size(), &length, name.data());
+		glGetActiveUniformBlockiv(ID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+		addVariable(uniformBlocks, std::string_view(name.data(), length), i, 0, dataSize);
+	}
+
+	//Vertex attributes
+	glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(maxLength > 0 ? maxLength : 1);
+	for (int i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		//Built-in inputs like gl_VertexID have no location
+		int location = glGetAttribLocation(ID, name.data());
+		if (location >= 0)
+			addVariable(attributes, std::string_view(name.data(), length), location, type, size);
+	}
+
+	auto byHash = [](const Variable &a, const Variable &b) { return a.hash < b.hash; };
+	std::sort(uniforms.begin(), uniforms.end(), byHash);
+	std::sort(uniformBlocks.begin(), uniformBlocks.end(), byHash);
+	std::sort(attributes.begin(), attributes.end(), byHash);
+}
+
+void Shader::addVariable(std::vector<Variable> &table, std::string_view name, int location, GLenum type, int size)
+{
+	Variable variable;
+	variable.hash = hashName(name);
+	variable.name = std::string(name);
+	variable.location = location;
+	variable.type = type;
+	variable.size = size;
+	table.push_back(std::move(variable));
+}
+
+const Shader::Variable* Shader::findVariable(const std::vector<Variable> &table, std::string_view name)
+{
+	const std::uint32_t hash = hashName(name);
+	auto it = std::lower_bound(table.begin(), table.end(), hash,
+		[](const Variable &variable, std::uint32_t value) { return variable.hash < value; });
+	for (; it != table.end() && it->hash == hash; ++it)
+	{
+		if (it->name == name)
+			return &*it;
+	}
+	return nullptr;
+}
+
+int Shader::getUniformLocation(std::string_view name)const
+{
+	const Variable* variable = findVariable(uniforms, name);
+	return variable ? variable->location : -1;
+}
+
+int Shader::getAttributeLocation(std::string_view name)const
+{
+	const Variable* variable = findVariable(attributes, name);
+	return variable ? variable->location : -1;
+}
+
+unsigned int Shader::getUniformBlockIndex(std::string_view name)const
+{
+	const Variable* variable = findVariable(uniformBlocks, name);
+	return variable ? (unsigned int)variable->location : GL_INVALID_INDEX;
+}
+
+const std::vector<Shader::Variable>& Shader::getActiveUniforms()const
+{
+	return uniforms;
+}
+
+const std::vector<Shader::Variable>& Shader::getActiveUniformBlocks()const
+{
+	return uniformBlocks;
+}
+
+const std::vector<Shader::Variable>& Shader::getActiveAttributes()const
+{
+	return attributes;
+}
+
+namespace
+{
+	//Components per location, number of locations and kind of a vertex shader input
+	//False for the types not listed (double inputs of GL 4.1...) : they are not checked
+	bool attributeShape(GLenum type, int &components, int &locations, bool &integer)
+	{
+		locations = 1;
+		integer = false;
+		switch (type)
+		{
+		case GL_FLOAT: components = 1; break;
+		case GL_FLOAT_VEC2: components = 2; break;
+		case GL_FLOAT_VEC3: components = 3; break;
+		case GL_FLOAT_VEC4: components = 4; break;
+		case GL_FLOAT_MAT2: components = 2; locations = 2; break;
+		case GL_FLOAT_MAT3: components = 3; locations = 3; break;
+		case GL_FLOAT_MAT4: components = 4; locations = 4; break;
+		case GL_FLOAT_MAT2x3: components = 3; locations = 2; break;
+		case GL_FLOAT_MAT2x4: components = 4; locations = 2; break;
+		case GL_FLOAT_MAT3x2: components = 2; locations = 3; break;
+		case GL_FLOAT_MAT3x4: components = 4; locations = 3; break;
+		case GL_FLOAT_MAT4x2: components = 2; locations = 4; break;
+		case GL_FLOAT_MAT4x3: components = 3; locations = 4; break;
+		case GL_INT: case GL_UNSIGNED_INT: components = 1; integer = true; break;
+		case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: components = 2; integer = true; break;
+		case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: components = 3; integer = true; break;
+		case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: components = 4; integer = true; break;
+		default: return false;
+		}
+		return true;
+	}
+}
+
+bool Shader::validateVertexLayout(unsigned int vao)const
+{
+	GLint previousVao = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVao);
+	glBindVertexArray(vao);
+
+	bool valid = true;
+	for (const Variable &attribute : attributes)
+	{
+		int components, locations;
+		bool integer;
+		if (!attributeShape(attribute.type, components, locations, integer))
+			continue;
+
+		for (int i = 0; i < locations * attribute.size; ++i)
+		{
+			const GLuint location = (GLuint)(attribute.location + i);
+			GLint enabled = 0, size = 0, isInteger = 0;
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &isInteger);
+
+			if (!enabled)
+			{
+				std::cout << "ERROR::SHADER::VERTEX_LAYOUT::ATTRIBUTE_NOT_ENABLED " << attribute.name << " (location " << location << ")" << std::endl;
+				valid = false;
+			}
+			else if ((isInteger != 0) != integer)
+			{
+				std::cout << "ERROR::SHADER::VERTEX_LAYOUT::TYPE " << attribute.name << " (location " << location << ") "
+					<< (integer ? "needs glVertexAttribIPointer" : "needs glVertexAttribPointer") << std::endl;
+				valid = false;
+			}
+			//Less components is fine, GL fills the missing ones with (0, 0, 0, 1) : a vec4 fed by 3 floats
+			//More is legal too, the extra ones are fetched and dropped
+			else if (size > components)
+				std::cout << "WARNING::SHADER::VERTEX_LAYOUT::COMPONENTS_IGNORED " << attribute.name << " (location " << location << ") reads "
+					<< components << " components, the array gives " << size << std::endl;
+		}
+	}
+
+	glBindVertexArray(previousVao);
+	return valid;
+}
+
+bool Shader::bindUniformBlock(std::string_view blockName, unsigned int binding)const
+{
+	const unsigned int index = getUniformBlockIndex(blockName);
+	if (index == GL_INVALID_INDEX)
+		return false;
+	glUniformBlockBinding(ID, index, binding);
+	return true;
 }
 
-void Shader::setBool(const std::string &name, bool value)const
+void Shader::setBool(std::string_view name, bool value)const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(getUniformLocation(name), (int)value);
 }
 
-void Shader::setInt(const std::string &name, int value)const
+void Shader::setInt(std::string_view name, int value)const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(getUniformLocation(name), value);
 }
 
-void Shader::setFloat(const std::string &name, float value)const
+void Shader::setFloat(std::string_view name, float value)const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(getUniformLocation(name), value);
 }
\ No newline at end of file
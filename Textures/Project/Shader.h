@@ -3,24 +3,147 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include "ShaderPreprocessor.h"
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
+
+//Shader source compiled into the executable, see embed_shaders.ps1 and EmbeddedShaders.h
+struct EmbeddedShader
+{
+	//Name of the original file, used to resolve #include between embedded files
+	const char* path;
+	std::string_view code;
+	//Shader::hashSource(code), computed by the compiler
+	std::uint64_t hash;
+};
 
 class Shader
 {
 public:
+	//Blocking -> the constructor waits for the link, like before
+	//Async -> the constructor only submits the work, poll() tells when the program can be used
+	enum class BuildMode { Blocking, Async };
+	enum class Status { Pending, Ready, Failed };
+
 	//Program ID
 	unsigned int ID;
 	//Glchar -> is a type similar to the C char, which serves to represent a narrow character
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, BuildMode mode = BuildMode::Blocking);
+	//Permutation of the same files : each define ("NAME" or "NAME=VALUE") is injected in both stages
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const std::vector<std::string> &defines, BuildMode mode = BuildMode::Blocking);
+	//Sources embedded at build time : no file I/O, the hash computed at compile time is the binary cache key
+	Shader(const EmbeddedShader &vertex, const EmbeddedShader &fragment, BuildMode mode = BuildMode::Blocking);
+	Shader(const EmbeddedShader &vertex, const EmbeddedShader &fragment, const std::vector<std::string> &defines, BuildMode mode = BuildMode::Blocking);
+	//Never waits when the driver has GL_KHR_parallel_shader_compile, else finishes the build right away
+	//Submit all the programs first, then poll them : the driver compiles them in parallel
+	Status poll();
+	Status getStatus() const;
 	//use/activate shader
 	void use() const;
 	//Utility Uniform functions
-	void setBool(const std::string &name, bool value)const;
-	void setInt(const std::string &name, int value)const;
-	void setFloat(const std::string &name, float value)const;
+	//The name is only hashed and looked up in the location table -> no allocation, no driver call
+	void setBool(std::string_view name, bool value)const;
+	void setInt(std::string_view name, int value)const;
+	void setFloat(std::string_view name, float value)const;
+	//Connect the uniform block blockName to a binding point (see UniformBuffer), false if the block is not active
+	bool bindUniformBlock(std::string_view blockName, unsigned int binding)const;
+
+	//Active uniform, uniform block or vertex attribute of the program
+	//The name is kept so that two names with the same hash can't be mixed up
+	struct Variable
+	{
+		std::uint32_t hash;
+		std::string name;
+		//Location for uniforms and attributes, block index for blocks
+		int location;
+		//GL_FLOAT_VEC3, GL_SAMPLER_2D... (0 for blocks)
+		GLenum type;
+		//Number of array elements, data size in bytes for blocks
+		int size;
+	};
+	//Reflection, everything is read from the tables built at link time
+	//Return the location cached at link time, -1 if the uniform is not active (like glGetUniformLocation)
+	int getUniformLocation(std::string_view name)const;
+	int getAttributeLocation(std::string_view name)const;
+	//GL_INVALID_INDEX if the block is not active
+	unsigned int getUniformBlockIndex(std::string_view name)const;
+	const std::vector<Variable>& getActiveUniforms()const;
+	const std::vector<Variable>& getActiveUniformBlocks()const;
+	const std::vector<Variable>& getActiveAttributes()const;
+	//Check that the attribute arrays enabled in vao feed every input of the vertex shader
+	//with the right kind (float or integer), warns when an array gives more components than read
+	//Meant to be called once when a VAO is first paired with the program, prints every mismatch
+	bool validateVertexLayout(unsigned int vao)const;
+
+	//Shared by every Shader so that variants reuse the files and expansions already done
+	static ShaderPreprocessor preprocessor;
+
+	//Folder where linked program binaries are cached between runs (empty -> cache disabled)
+	static std::string binaryCacheDirectory;
+
+	//64 bits FNV-1a hash of a shader source, seed allows to chain several strings
+	static constexpr std::uint64_t hashSource(std::string_view source, std::uint64_t seed = 14695981039346656037ull)
+	{
+		std::uint64_t hash = seed;
+		for (char c : source)
+		{
+			hash ^= (unsigned char)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//FNV-1a hash of a uniform name, constexpr so that literals can be hashed at compile time
+	static constexpr std::uint32_t hashName(std::string_view name)
+	{
+		std::uint32_t hash = 2166136261u;
+		for (char c : name)
+		{
+			hash ^= (unsigned char)c;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+private:
+	//ShaderWatcher recompiles the files below and swaps ID when they change
+	friend class ShaderWatcher;
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::vector<std::string> defines;
+
+	Status status = Status::Pending;
+	//Stages kept alive until the build is finished
+	unsigned int vertexStage = 0;
+	unsigned int fragmentStage = 0;
+	std::uint64_t cacheKey = 0;
+
+	void build(BuildMode mode, const EmbeddedShader* vertex, const EmbeddedShader* fragment);
+	void submit(const ShaderSource &vertexSource, const ShaderSource &fragmentSource, std::uint64_t vertexHash, std::uint64_t fragmentHash);
+	void finishBuild();
+	static bool parallelCompileSupported();
+
+	//Flat tables sorted by hash, filled once after the link
+	std::vector<Variable> uniforms;
+	std::vector<Variable> uniformBlocks;
+	std::vector<Variable> attributes;
+
+	//Query the whole interface of the program once, right after the link
+	void buildReflection();
+	static void addVariable(std::vector<Variable> &table, std::string_view name, int location, GLenum type, int size);
+	static const Variable* findVariable(const std::vector<Variable> &table, std::string_view name);
+
+	//Program binary cache, the key covers both sources and the driver (vendor, renderer, version)
+	static bool programBinarySupported();
+	static std::uint64_t programCacheKey(std::uint64_t vertexHash, std::uint64_t fragmentHash);
+	static std::string programCachePath(std::uint64_t key);
+	bool loadProgramBinary(std::uint64_t key);
+	void saveProgramBinary(std::uint64_t key)const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,261 @@
+#include "ShaderPreprocessor.h"
+#include "Shader.h"
+#include <algorithm>
+#include <filesystem>
+
+namespace
+{
+	std::string normalizePath(const std::filesystem::path &path)
+	{
+		return path.lexically_normal().generic_string();
+	}
+
+	std::string folderOf(const std::string &path)
+	{
+		return std::filesystem::path(path).parent_path().generic_string();
+	}
+
+	//Return the file name of an #include "file" / #include <file> line, empty if the line is something else
+	std::string_view includedFile(std::string_view line)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string_view::npos || line[i] != '#')
+			return {};
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string_view::npos || line.compare(i, 7, "include") != 0)
+			return {};
+		i = line.find_first_not_of(" \t", i + 7);
+		if (i == std::string_view::npos || (line[i] != '"' && line[i] != '<'))
+			return {};
+		const char close = line[i] == '"' ? '"' : '>';
+		const size_t end = line.find(close, i + 1);
+		if (end == std::string_view::npos)
+			return {};
+		return line.substr(i + 1, end - i - 1);
+	}
+}
+
+std::uint64_t ShaderSource::hash() const
+{
+	return Shader::hashSource(tail, Shader::hashSource(defines, Shader::hashSource(head)));
+}
+
+void ShaderSource::upload(unsigned int shader) const
+{
+	//Empty pieces are skipped, an empty view may hold a null pointer that the driver would reject
+	const std::string_view pieces[3] = { head, defines, tail };
+	const GLchar* strings[3];
+	GLint lengths[3];
+	GLsizei count = 0;
+	for (const std::string_view &piece : pieces)
+	{
+		if (piece.empty())
+			continue;
+		strings[count] = piece.data();
+		lengths[count] = (GLint)piece.size();
+		++count;
+	}
+	glShaderSource(shader, count, strings, lengths);
+}
+
+const ShaderPreprocessor::SourceFile* ShaderPreprocessor::load(const std::string &path)
+{
+	auto it = files.find(path);
+	if (it != files.end())
+		return &it->second;
+
+	SourceFile source;
+	if (!source.file.open(path))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << " : " << source.file.getError() << std::endl;
+		return nullptr;
+	}
+	source.code = source.file.view();
+	source.hash = Shader::hashSource(source.code);
+	return &files.emplace(path, std::move(source)).first->second;
+}
+
+const ShaderPreprocessor::Expansion* ShaderPreprocessor::expansionOf(const std::string &path)
+{
+	const std::string root = normalizePath(path);
+	const SourceFile* source = load(root);
+	if (!source)
+		return nullptr;
+
+	//Includes are relative to the file -> the folder is part of the key
+	const std::uint64_t key = Shader::hashSource(folderOf(root), source->hash);
+	auto it = expansions.find(key);
+	if (it != expansions.end())
+		return &it->second;
+
+	Expansion expansion;
+	const std::string_view content = source->code;
+	if (content.find("include") == std::string_view::npos)
+	{
+		//Nothing to expand, the driver reads the mapped file directly
+		expansion.dependencies.push_back(root);
+		expansion.code = content;
+	}
+	else
+	{
+		expansion.expanded.reserve(content.size());
+		if (!expandInto(root, expansion, 0))
+			return nullptr;
+	}
+
+	Expansion &cached = expansions.emplace(key, std::move(expansion)).first->second;
+	//Set once the string has reached its final place in the table
+	if (!cached.expanded.empty())
+		cached.code = cached.expanded;
+	return &cached;
+}
+
+bool ShaderPreprocessor::expand(const std::string &path, std::string_view &code)
+{
+	const Expansion* expansion = expansionOf(path);
+	if (!expansion)
+		return false;
+	code = expansion->code;
+	return true;
+}
+
+bool ShaderPreprocessor::expandInto(const std::string &path, Expansion &expansion, int sourceIndex)
+{
+	expansion.dependencies.push_back(path);
+	//References into an unordered_map stay valid when includes are added to it
+	const std::string_view code = load(path)->code;
+	const std::string folder = folderOf(path);
+
+	size_t lineNumber = 1;
+	for (size_t begin = 0; begin < code.size(); ++lineNumber)
+	{
+		size_t end = code.find('\n', begin);
+		if (end == std::string_view::npos)
+			end = code.size();
+		const std::string_view line = code.substr(begin, end - begin);
+		begin = end + 1;
+
+		const std::string_view name = includedFile(line);
+		if (name.empty())
+		{
+			expansion.expanded.append(line.data(), line.size());
+			expansion.expanded += '\n';
+			continue;
+		}
+
+		const std::string includePath = normalizePath(std::filesystem::path(folder) / std::string(name));
+		const bool alreadyIncluded = std::find(expansion.dependencies.begin(), expansion.dependencies.end(), includePath) != expansion.dependencies.end();
+		if (alreadyIncluded)
+		{
+			expansion.expanded += '\n';
+			continue;
+		}
+		if (!load(includePath))
+		{
+			std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << " (" << path << ":" << lineNumber << ")" << std::endl;
+			return false;
+		}
+		//#line keeps the compiler errors pointing at the right file (source string number) and line
+		const int includeIndex = (int)expansion.dependencies.size();
+		expansion.expanded += "#line 1 " + std::to_string(includeIndex) + "\n";
+		if (!expandInto(includePath, expansion, includeIndex))
+			return false;
+		expansion.expanded += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceIndex) + "\n";
+	}
+	return true;
+}
+
+bool ShaderPreprocessor::variant(const std::string &path, const std::vector<std::string> &defines, ShaderSource &source)
+{
+	const Expansion* expansion = expansionOf(path);
+	if (!expansion)
+		return false;
+
+	const std::string_view code = expansion->code;
+	source.files = expansion->dependencies;
+	source.head = code;
+	source.defines.clear();
+	source.tail = std::string_view();
+	if (defines.empty())
+		return true;
+
+	for (const std::string &define : defines)
+	{
+		const size_t equal = define.find('=');
+		source.defines += "#define ";
+		if (equal == std::string::npos)
+			source.defines += define;
+		else
+			source.defines += define.substr(0, equal) + " " + define.substr(equal + 1);
+		source.defines += '\n';
+	}
+
+	//#version has to stay the first directive of the shader
+	size_t insert = 0;
+	const size_t version = code.find("#version");
+	if (version != std::string_view::npos)
+	{
+		const size_t end = code.find('\n', version);
+		insert = end == std::string_view::npos ? code.size() : end + 1;
+		//Keep the line numbers of the errors unchanged
+		const size_t versionLine = std::count(code.begin(), code.begin() + insert, '\n');
+		source.defines += "#line " + std::to_string(versionLine + 1) + " 0\n";
+	}
+	source.head = code.substr(0, insert);
+	source.tail = code.substr(insert);
+	return true;
+}
+
+void ShaderPreprocessor::invalidate(const std::string &path)
+{
+	const std::string file = normalizePath(path);
+	files.erase(file);
+	for (auto it = expansions.begin(); it != expansions.end(); )
+	{
+		const std::vector<std::string> &dependencies = it->second.dependencies;
+		if (std::find(dependencies.begin(), dependencies.end(), file) != dependencies.end())
+			it = expansions.erase(it);
+		else
+			++it;
+	}
+}
+
+void ShaderPreprocessor::release()
+{
+	//An expansion without include is the root file itself, it goes with the mapping
+	//The others own their expanded string and stay cached
+	for (auto it = expansions.begin(); it != expansions.end(); )
+	{
+		const auto root = files.find(it->second.dependencies.front());
+		if (it->second.expanded.empty() && root != files.end() && root->second.file.isOpen())
+			it = expansions.erase(it);
+		else
+			++it;
+	}
+	//Embedded sources are not mapped, they stay
+	for (auto it = files.begin(); it != files.end(); )
+	{
+		if (it->second.file.isOpen())
+			it = files.erase(it);
+		else
+			++it;
+	}
+}
+
+void ShaderPreprocessor::addEmbedded(const std::string &path, std::string_view code, std::uint64_t hash)
+{
+	const std::string file = normalizePath(path);
+	auto it = files.find(file);
+	//Registering the same content again keeps the expansions already cached
+	if (it != files.end())
+	{
+		if (it->second.hash == hash && !it->second.file.isOpen())
+			return;
+		invalidate(file);
+	}
+
+	SourceFile source;
+	source.code = code;
+	source.hash = hash;
+	files.emplace(file, std::move(source));
+}
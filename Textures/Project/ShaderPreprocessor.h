@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//Shader source handed to glShaderSource in pieces, nothing is concatenated :
+//head and tail point into the mapped file (or the cached expansion), defines is the injected block
+//The views stay valid until the preprocessor invalidates the file or releases its mappings
+struct ShaderSource
+{
+	std::string_view head;
+	std::string defines;
+	std::string_view tail;
+	//Every file read to build it, the root file first : what to watch for edits
+	std::vector<std::string> files;
+
+	//Same value as Shader::hashSource of the whole concatenated source
+	std::uint64_t hash() const;
+	//glShaderSource with the three pieces and their lengths
+	void upload(unsigned int shader) const;
+};
+
+//Resolves #include "file" in shader sources and injects permutation #defines
+//Expanded sources are cached by content hash, so building N variants of one material expands
+//the shared files only once
+//Files are memory mapped only until release() : a mapped file can't be saved in place on Windows
+//(ERROR_USER_MAPPED_FILE) and truncating it on Linux makes reading the mapping fault
+class ShaderPreprocessor
+{
+public:
+	//Source of path with every #include resolved (a file is only included once per expansion)
+	//A file without #include is returned as is, straight from the mapping
+	//Returns false and prints why if the file or one of its includes can't be read
+	bool expand(const std::string &path, std::string_view &code);
+	//Expanded source with a "#define NAME" line per entry injected right after #version
+	//"NAME=VALUE" entries give "#define NAME VALUE"
+	bool variant(const std::string &path, const std::vector<std::string> &defines, ShaderSource &source);
+	//Forget a file edited on disk and every expansion that used it
+	void invalidate(const std::string &path);
+	//Unmap the files read from disk, with the expansions that point into them
+	//Call once glShaderSource has taken the sources (the driver keeps its own copy)
+	void release();
+	//Serve path from memory (shader embedded in the executable), it is never looked for on disk
+	//The hash must be Shader::hashSource(code), code must outlive the preprocessor
+	void addEmbedded(const std::string &path, std::string_view code, std::uint64_t hash);
+
+private:
+	struct SourceFile
+	{
+		//Not opened for embedded sources
+		MappedFile file;
+		std::string_view code;
+		std::uint64_t hash;
+	};
+	struct Expansion
+	{
+		//Only filled when the file has includes, else code points into the mapping
+		std::string expanded;
+		std::string_view code;
+		std::vector<std::string> dependencies;
+	};
+
+	//path -> content as mapped from disk or embedded
+	std::unordered_map<std::string, SourceFile> files;
+	//hash of folder + content of the root file -> expanded source
+	std::unordered_map<std::uint64_t, Expansion> expansions;
+
+	const SourceFile* load(const std::string &path);
+	//Cached expansion of path, made first if needed, nullptr if a file can't be read
+	const Expansion* expansionOf(const std::string &path);
+	bool expandInto(const std::string &path, Expansion &expansion, int sourceIndex);
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include "ShaderWatcher.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	//Same form as the paths of ShaderSource::files
+	std::string normalizePath(const std::filesystem::path &path)
+	{
+		return path.lexically_normal().generic_string();
+	}
+
+	//Empty for a file of the working folder
+	std::string folderOf(const std::string &path)
+	{
+		return std::filesystem::path(path).parent_path().generic_string();
+	}
+
+	//Active name of an array is "name[0]" -> "name"
+	std::string baseNameOf(const std::string &activeName)
+	{
+		if (activeName.size() > 3 && activeName.compare(activeName.size() - 3, 3, "[0]") == 0)
+			return activeName.substr(0, activeName.size() - 3);
+		return activeName;
+	}
+}
+
+ShaderWatcher::ShaderWatcher(Shader &shader)
+	: shader(shader)
+{
+	stages[0].type = GL_VERTEX_SHADER;
+	stages[0].label = "VERTEX";
+	stages[0].path = shader.vertexFile;
+	stages[1].type = GL_FRAGMENT_SHADER;
+	stages[1].label = "FRAGMENT";
+	stages[1].path = shader.fragmentFile;
+
+	//Compiled once now, so that an edit only costs the compilation of the edited stage
+	for (Stage &stage : stages)
+	{
+		//Watched even if it does not compile yet, the fix is an edit too
+		stage.files.push_back(normalizePath(stage.path));
+		compileStage(stage);
+	}
+
+#ifdef __linux__
+	inotifyFd = inotify_init1(IN_CLOEXEC);
+	if (inotifyFd < 0 || pipe(stopPipe) != 0)
+	{
+		std::cout << "ERROR::SHADER::WATCHER::INOTIFY_INIT_FAILED" << std::endl;
+		return;
+	}
+#endif
+	watchFiles();
+	thread = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (stopPipe[1] >= 0)
+	{
+		const char stop = 1;
+		(void)write(stopPipe[1], &stop, 1);
+	}
+#else
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopRequested = true;
+	}
+	stopCondition.notify_one();
+#endif
+	if (thread.joinable())
+		thread.join();
+#ifdef __linux__
+	if (inotifyFd >= 0)
+		close(inotifyFd);
+	if (stopPipe[0] >= 0)
+		close(stopPipe[0]);
+	if (stopPipe[1] >= 0)
+		close(stopPipe[1]);
+#endif
+	for (Stage &stage : stages)
+	{
+		if (stage.object)
+			glDeleteShader(stage.object);
+	}
+}
+
+void ShaderWatcher::watchLoop()
+{
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		if (fds[1].revents)
+			return;
+
+		const ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			if (event->len == 0)
+				continue;
+			std::lock_guard<std::mutex> lock(mutex);
+			const auto folder = folders.find(event->wd);
+			if (folder != folders.end())
+				fileEdited(normalizePath(std::filesystem::path(folder->second) / event->name));
+		}
+	}
+#else
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopCondition.wait_for(lock, std::chrono::milliseconds(250), [this] { return stopRequested; }))
+	{
+		for (auto &file : watched)
+		{
+			std::error_code error;
+			const auto lastWrite = std::filesystem::last_write_time(file.first, error);
+			if (!error && lastWrite != file.second.lastWrite)
+			{
+				file.second.lastWrite = lastWrite;
+				fileEdited(file.first);
+			}
+		}
+	}
+#endif
+}
+
+bool ShaderWatcher::update()
+{
+	//Fast path, the render loop pays two relaxed loads when nothing changed
+	if (!stages[0].dirty.load(std::memory_order_relaxed) && !stages[1].dirty.load(std::memory_order_relaxed))
+		return false;
+	//An async build still running owns its stages and shader.ID : resolve it first, the flags stay set
+	//so that the edit is picked up by a next frame
+	if (shader.poll() == Shader::Status::Pending)
+		return false;
+
+	bool dirty[2];
+	std::vector<std::string> files;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.swap(edited);
+		for (int i = 0; i < 2; ++i)
+			dirty[i] = stages[i].dirty.exchange(false, std::memory_order_acquire);
+	}
+	//Drop the old content from the preprocessor cache before expanding the files again :
+	//an edited include also drops the expansions of every stage file that includes it
+	for (const std::string &file : files)
+		Shader::preprocessor.invalidate(file);
+
+	bool compiled = true;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (dirty[i])
+			compiled = compileStage(stages[i]) && compiled;
+	}
+	//An edit may have added or removed an #include
+	watchFiles();
+	//Keep the running program when an edit does not compile
+	if (!compiled || !stages[0].object || !stages[1].object)
+		return false;
+
+	const unsigned int program = glCreateProgram();
+	glAttachShader(program, stages[0].object);
+	glAttachShader(program, stages[1].object);
+	glLinkProgram(program);
+	glDetachShader(program, stages[0].object);
+	glDetachShader(program, stages[1].object);
+
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::RELOAD::LINKING_FAILED\n" << infoLog << std::endl;
+		glDeleteProgram(program);
+		return false;
+	}
+
+	//The new program starts with default uniforms, carry over what the application has set
+	copyUniforms(shader.ID, program);
+
+	GLint current = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+	const unsigned int previous = shader.ID;
+	shader.ID = program;
+	shader.status = Shader::Status::Ready;
+	shader.buildReflection();
+	if ((unsigned int)current == previous)
+		GLStateCache::get().useProgram(program);
+	GLStateCache::get().forgetProgram(previous);
+	glDeleteProgram(previous);
+	return true;
+}
+
+bool ShaderWatcher::compileStage(Stage &stage)
+{
+	ShaderSource source;
+	if (!Shader::preprocessor.variant(stage.path, shader.defines, source))
+	{
+		Shader::preprocessor.release();
+		return false;
+	}
+
+	const unsigned int object = glCreateShader(stage.type);
+	source.upload(object);
+	//glShaderSource has copied it, the editor may save the next version while this one compiles
+	Shader::preprocessor.release();
+	glCompileShader(object);
+
+	int success;
+	glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(object, 512, NULL, infoLog);
+		std::cout << "ERROR::" << stage.label << "::SHADER::RELOAD::COMPILATION::FAILED\n" << infoLog << "\n";
+		glDeleteShader(object);
+		return false;
+	}
+
+	if (stage.object)
+		glDeleteShader(stage.object);
+	stage.object = object;
+	stage.files = std::move(source.files);
+	return true;
+}
+
+void ShaderWatcher::watchFiles()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unordered_map<std::string, WatchedFile> previous;
+	previous.swap(watched);
+	for (int i = 0; i < 2; ++i)
+	{
+		for (const std::string &path : stages[i].files)
+		{
+			const auto known = previous.find(path);
+			WatchedFile &file = watched[path];
+			file.stages |= 1u << i;
+#ifdef __linux__
+			//The folder is watched rather than the file : most editors save by replacing the file
+			//Adding the same folder again gives back the same watch
+			if (known == previous.end() && inotifyFd >= 0)
+			{
+				const std::string folder = folderOf(path);
+				const int watch = inotify_add_watch(inotifyFd, folder.empty() ? "." : folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (watch >= 0)
+					folders[watch] = folder;
+			}
+#else
+			if (known != previous.end())
+				file.lastWrite = known->second.lastWrite;
+			else
+			{
+				std::error_code error;
+				file.lastWrite = std::filesystem::last_write_time(path, error);
+			}
+#endif
+		}
+	}
+}
+
+void ShaderWatcher::fileEdited(const std::string &path)
+{
+	const auto file = watched.find(path);
+	if (file == watched.end())
+		return;
+	if (std::find(edited.begin(), edited.end(), path) == edited.end())
+		edited.push_back(path);
+	for (int i = 0; i < 2; ++i)
+	{
+		if (file->second.stages & (1u << i))
+			stages[i].dirty.store(true, std::memory_order_release);
+	}
+}
+
+void ShaderWatcher::copyUniforms(unsigned int from, unsigned int to)
+{
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(to);
+
+	int count = 0;
+	int maxLength = 0;
+	//Type of each uniform of the new program : an edit may have changed it (vec3 -> vec4, float -> int),
+	//the old value can't be set with the call of the new type
+	std::unordered_map<std::string, GLenum> targetTypes;
+	glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(to, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> name(maxLength > 0 ? maxLength : 1);
+	for (int i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(to, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		targetTypes[baseNameOf(std::string(name.data(), length))] = type;
+	}
+
+	glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(from, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	name.resize(maxLength > 0 ? maxLength : 1);
+
+	for (int i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(from, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+		//Arrays are copied one element at a time, "name[0]" -> "name[i]"
+		const std::string activeName(name.data(), length);
+		const std::string baseName = baseNameOf(activeName);
+		if (baseName.size() == activeName.size())
+			size = 1;
+		const auto targetType = targetTypes.find(baseName);
+		if (targetType == targetTypes.end() || targetType->second != type)
+			continue;
+
+		for (GLint element = 0; element < size; ++element)
+		{
+			const std::string elementName = size > 1 ? baseName + "[" + std::to_string(element) + "]" : baseName;
+			const int source = glGetUniformLocation(from, elementName.c_str());
+			const int target = glGetUniformLocation(to, elementName.c_str());
+			if (source < 0 || target < 0)
+				continue;
+
+			GLfloat f[16];
+			GLint n[16];
+			GLuint u[16];
+			switch (type)
+			{
+			case GL_FLOAT: glGetUniformfv(from, source, f); glUniform1fv(target, 1, f); break;
+			case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glUniform2fv(target, 1, f); break;
+			case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glUniform3fv(target, 1, f); break;
+			case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glUniform4fv(target, 1, f); break;
+			case GL_FLOAT_MAT2: glGetUniformfv(from, source, f); glUniformMatrix2fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT3: glGetUniformfv(from, source, f); glUniformMatrix3fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4: glGetUniformfv(from, source, f); glUniformMatrix4fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT2x3: glGetUniformfv(from, source, f); glUniformMatrix2x3fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT2x4: glGetUniformfv(from, source, f); glUniformMatrix2x4fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT3x2: glGetUniformfv(from, source, f); glUniformMatrix3x2fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT3x4: glGetUniformfv(from, source, f); glUniformMatrix3x4fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4x2: glGetUniformfv(from, source, f); glUniformMatrix4x2fv(target, 1, GL_FALSE, f); break;
+			case GL_FLOAT_MAT4x3: glGetUniformfv(from, source, f); glUniformMatrix4x3fv(target, 1, GL_FALSE, f); break;
+			case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, n); glUniform2iv(target, 1, n); break;
+			case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, n); glUniform3iv(target, 1, n); break;
+			case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, n); glUniform4iv(target, 1, n); break;
+			case GL_UNSIGNED_INT: glGetUniformuiv(from, source, u); glUniform1uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, u); glUniform2uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, u); glUniform3uiv(target, 1, u); break;
+			case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, u); glUniform4uiv(target, 1, u); break;
+			//int, bool and every sampler type hold a single integer
+			default: glGetUniformiv(from, source, n); glUniform1iv(target, 1, n); break;
+			}
+		}
+	}
+
+	//Uniform block bindings belong to the program too
+	int blocks = 0;
+	glGetProgramiv(from, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+	glGetProgramiv(from, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength > 0 ? maxLength : 1);
+	for (int i = 0; i < blocks; ++i)
+	{
+		GLint binding = 0;
+		glGetActiveUniformBlockiv(from, (GLuint)i, GL_UNIFORM_BLOCK_BINDING, &binding);
+		glGetActiveUniformBlockName(from, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+		const unsigned int index = glGetUniformBlockIndex(to, name.data());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(to, index, (GLuint)binding);
+	}
+
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "Shader.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifndef __linux__
+#include <condition_variable>
+#include <filesystem>
+#endif
+
+//Hot reload for a Shader : watches the files of its two stages, #include files included,
+//and rebuilds the program when one of them is saved
+//Linux -> inotify on the shader folders, other platforms -> timestamp polling
+//The watching is done by a background thread, update() only reads two flags when nothing changed
+class ShaderWatcher
+{
+public:
+	ShaderWatcher(Shader &shader);
+	~ShaderWatcher();
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	//Call once per frame from the thread owning the GL context
+	//Only the edited stage is recompiled, shader.ID is replaced only if the new program links
+	//Returns true when the program has been swapped
+	bool update();
+
+private:
+	struct Stage
+	{
+		GLenum type;
+		const char* label;
+		std::string path;
+		//Files of the last expansion that compiled, the stage file first
+		std::vector<std::string> files;
+		unsigned int object = 0;
+		std::atomic<bool> dirty{ false };
+	};
+	struct WatchedFile
+	{
+		//Bit i set when stages[i] reads the file
+		unsigned int stages = 0;
+#ifndef __linux__
+		std::filesystem::file_time_type lastWrite;
+#endif
+	};
+
+	Shader &shader;
+	Stage stages[2];
+	std::thread thread;
+	//Guards watched and edited, shared by update() and the watching thread
+	std::mutex mutex;
+	//Normalized path -> stages reading it
+	std::unordered_map<std::string, WatchedFile> watched;
+	//Files saved since the last update(), to drop from the preprocessor cache
+	std::vector<std::string> edited;
+#ifdef __linux__
+	int inotifyFd = -1;
+	int stopPipe[2] = { -1, -1 };
+	//inotify watch -> folder it is on
+	std::unordered_map<int, std::string> folders;
+#else
+	std::condition_variable stopCondition;
+	bool stopRequested = false;
+#endif
+
+	void watchLoop();
+	bool compileStage(Stage &stage);
+	//Rebuild watched from the files of the stages, after they have been compiled
+	void watchFiles();
+	//A file was saved : mark the stages reading it, called with mutex held
+	void fileEdited(const std::string &path);
+	static void copyUniforms(unsigned int from, unsigned int to);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+//The buffer is only ever bound to GL_COPY_WRITE_BUFFER here : no VAO, nor cached binding, is touched
+
+StreamBuffer::StreamBuffer(std::size_t frameSize, unsigned int frameCount)
+	: frameSize((std::max<std::size_t>(frameSize, 1) + 255) & ~(std::size_t)255), fences(std::max(frameCount, 1u), nullptr)
+{
+	const std::size_t size = this->frameSize * fences.size();
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	//GL 4.4 / ARB_buffer_storage -> mapped once for the whole life of the buffer
+	persistent = hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage");
+	if (persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		memory = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		persistent = memory != nullptr;
+	}
+	if (!persistent)
+	{
+		//A buffer made by glBufferStorage can't be respecified : start again from a new one
+		glDeleteBuffers(1, &buffer);
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+		copy.resize(this->frameSize);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync fence : fences)
+		if (fence)
+			glDeleteSync(fence);
+	if (persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	GLStateCache::get().forgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::beginFrame()
+{
+	if (inFrame)
+		endFrame();
+	inFrame = true;
+	head = flushed = 0;
+	GLsync &fence = fences[region];
+	if (!fence)
+		return;
+	//Nearly always signaled already, the CPU only waits when it is frameCount frames ahead
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		//The first wait flushes the fence to the GPU, otherwise it may never be signaled
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		do
+		{
+			result = glClientWaitSync(fence, flags, 1000000);
+			flags = 0;
+		} while (result == GL_TIMEOUT_EXPIRED);
+		const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		++frame.stalls;
+		frame.stallMilliseconds += elapsed;
+		frame.longestStallMilliseconds = std::max(frame.longestStallMilliseconds, elapsed);
+	}
+	if (result == GL_WAIT_FAILED)
+		std::cout << "ERROR::STREAM_BUFFER::WAIT_FAILED" << std::endl;
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(std::size_t size, std::size_t alignment)
+{
+	Allocation allocation;
+	if (!inFrame)
+		beginFrame();
+	//The region starts on 256, aligning inside it is enough
+	const std::size_t offset = (head + alignment - 1) & ~(alignment - 1);
+	if (size > frameSize || offset > frameSize - size)
+	{
+		++frame.overflows;
+		return allocation;
+	}
+	head = offset + size;
+	allocation.memory = persistent ? memory + region * frameSize + offset : copy.data() + offset;
+	allocation.offset = region * frameSize + offset;
+	allocation.size = size;
+	++frame.allocations;
+	frame.bytes += size;
+	return allocation;
+}
+
+void StreamBuffer::flush()
+{
+	if (persistent || head == flushed)
+		return;
+	//The fences already keep this range away from the GPU, no implicit sync to fear
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, region * frameSize + flushed, head - flushed, copy.data() + flushed);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	flushed = head;
+}
+
+StreamBuffer::Stats StreamBuffer::endFrame()
+{
+	flush();
+	if (head > 0)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % (unsigned int)fences.size();
+	inFrame = false;
+	head = flushed = 0;
+
+	frame.frames = 1;
+	total.frames += frame.frames;
+	total.allocations += frame.allocations;
+	total.bytes += frame.bytes;
+	total.overflows += frame.overflows;
+	total.stalls += frame.stalls;
+	total.stallMilliseconds += frame.stallMilliseconds;
+	total.longestStallMilliseconds = std::max(total.longestStallMilliseconds, frame.longestStallMilliseconds);
+	const Stats ended = frame;
+	frame = Stats();
+	return ended;
+}
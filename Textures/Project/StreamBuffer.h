@@ -0,0 +1,90 @@
+#pragma once
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+//Buffer for the geometry rebuilt every frame (particles, UI, debug lines) without glBufferData :
+//	- one buffer cut into frameCount regions, each frame writes into the next one
+//	- GL 4.4 / ARB_buffer_storage : mapped once, persistent and coherent, the CPU writes where the GPU reads
+//	  without any map or copy call. Otherwise the writes go to a CPU copy of the region, sent by flush()
+//	- endFrame() puts a fence after the draws of the frame, beginFrame() waits on the fence of the region
+//	  it is about to reuse : with 3 regions the CPU runs up to 2 frames ahead of the GPU before it stalls
+//Inside a frame allocate() only moves an offset forward, nothing is freed until the region comes back
+//	stream.beginFrame();
+//	StreamBuffer::Allocation lines = stream.allocate(count * sizeof(LineVertex));
+//	std::memcpy(lines.memory, vertices, lines.size);
+//	stream.flush();
+//	glDrawArrays(GL_LINES, (GLint)(lines.offset / sizeof(LineVertex)), count);
+//	stream.endFrame();
+class StreamBuffer
+{
+public:
+	//Room for one allocate(), memory is null when the region of the frame is full
+	struct Allocation
+	{
+		//Write the data here, never read it back (write combined memory)
+		void* memory = nullptr;
+		//Where it is in the buffer : attribute pointer offset, draw first vertex, glBindBufferRange...
+		std::size_t offset = 0;
+		std::size_t size = 0;
+	};
+
+	struct Stats
+	{
+		unsigned int frames = 0;
+		unsigned int allocations = 0;
+		std::size_t bytes = 0;
+		//allocate() calls refused because the region was full
+		unsigned int overflows = 0;
+		//beginFrame() calls that found the region still used by the GPU, and the time spent waiting for it
+		unsigned int stalls = 0;
+		double stallMilliseconds = 0.0;
+		double longestStallMilliseconds = 0.0;
+	};
+
+	//frameSize : bytes one frame may allocate, rounded up to 256 so that every region is aligned for
+	//glBindBufferRange too
+	StreamBuffer(std::size_t frameSize, unsigned int frameCount = 3);
+	~StreamBuffer();
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	//Call once per frame before the first allocate(), waits for the GPU when it still reads the region
+	void beginFrame();
+	//alignment : power of two, the offset is a multiple of it from the start of the buffer
+	Allocation allocate(std::size_t size, std::size_t alignment = 16);
+	//Sends what was allocated since the last flush(), to call before the draws that read it
+	//Nothing to do with a persistent mapping
+	void flush();
+	//Call once per frame after the last draw that reads the region, returns the counters of the frame
+	Stats endFrame();
+
+	unsigned int getBuffer() const { return buffer; }
+	bool isPersistent() const { return persistent; }
+	std::size_t getFrameSize() const { return frameSize; }
+	//Since the streamer was made
+	const Stats& getTotal() const { return total; }
+
+private:
+	unsigned int buffer = 0;
+	unsigned char* memory = nullptr;
+	bool persistent = false;
+	std::size_t frameSize;
+	//One fence per region, 0 while the GPU has nothing to read in it
+	std::vector<GLsync> fences;
+	unsigned int region = 0;
+	//Next free byte and first byte not flushed yet, from the start of the region
+	std::size_t head = 0;
+	std::size_t flushed = 0;
+	bool inFrame = false;
+	//Writes of the region when the buffer is not mapped
+	std::vector<unsigned char> copy;
+
+	Stats frame;
+	Stats total;
+};
+
+#endif
@@ -0,0 +1,367 @@
+#include "TextureAtlas.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+	int alignUp(int value, int alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//Cells start on multiples of the padding (4 at least, the size of a compressed block)
+	int cellAlignment(int padding)
+	{
+		return std::max(padding, 4);
+	}
+
+	//Image, its gutter on both sides, then what is left to the next multiple of the alignment
+	int cellSize(int size, int padding)
+	{
+		return alignUp(size + padding * 2, cellAlignment(padding));
+	}
+
+	//Texel of a 1 to 4 channels image as RGBA
+	void readTexel(const unsigned char* texel, int channels, unsigned char* rgba)
+	{
+		if (channels < 3)
+		{
+			rgba[0] = rgba[1] = rgba[2] = texel[0];
+			rgba[3] = channels == 2 ? texel[1] : 255;
+		}
+		else
+		{
+			rgba[0] = texel[0];
+			rgba[1] = texel[1];
+			rgba[2] = texel[2];
+			rgba[3] = channels == 4 ? texel[3] : 255;
+		}
+	}
+
+	void writeTexel(const unsigned char* rgba, int channels, unsigned char* texel)
+	{
+		switch (channels)
+		{
+		case 1: texel[0] = rgba[0]; break;
+		case 2: texel[0] = rgba[0]; texel[1] = rgba[3]; break;
+		case 3: texel[0] = rgba[0]; texel[1] = rgba[1]; texel[2] = rgba[2]; break;
+		default: texel[0] = rgba[0]; texel[1] = rgba[1]; texel[2] = rgba[2]; texel[3] = rgba[3]; break;
+		}
+	}
+}
+
+//---------- AtlasTable ----------
+
+//Text file :
+//	atlas <width> <height>
+//	<x> <y> <width> <height> <name>   one line per image
+bool AtlasTable::load(const std::string &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return read(text, path);
+}
+
+bool AtlasTable::read(std::string_view text, const std::string &path)
+{
+	std::istringstream file{ std::string(text) };
+	std::string keyword;
+	if (!(file >> keyword >> width >> height) || keyword != "atlas")
+	{
+		std::cout << "ERROR::ATLAS::TABLE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		width = height = 0;
+		return false;
+	}
+	regions.clear();
+	AtlasRegion region;
+	while (file >> region.x >> region.y >> region.width >> region.height)
+	{
+		//The name is the rest of the line, it may hold spaces
+		std::getline(file >> std::ws, region.name);
+		region.u0 = (float)region.x / width;
+		region.v0 = (float)region.y / height;
+		region.u1 = (float)(region.x + region.width) / width;
+		region.v1 = (float)(region.y + region.height) / height;
+		regions.push_back(region);
+	}
+	return true;
+}
+
+bool AtlasTable::save(const std::string &path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	file << "atlas " << width << " " << height << "\n";
+	for (const AtlasRegion &region : regions)
+		file << region.x << " " << region.y << " " << region.width << " " << region.height << " " << region.name << "\n";
+	return (bool)file;
+}
+
+const AtlasRegion* AtlasTable::find(const std::string &name) const
+{
+	for (const AtlasRegion &region : regions)
+		if (region.name == name)
+			return &region;
+	return nullptr;
+}
+
+bool AtlasTable::remapUVs(const std::string &name, float* vertices, int vertexCount, int stride, int uvOffset) const
+{
+	const AtlasRegion* region = find(name);
+	if (!region)
+	{
+		std::cout << "ERROR::ATLAS::IMAGE_NOT_FOUND " << name << std::endl;
+		return false;
+	}
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		float* uv = vertices + i * stride + uvOffset;
+		uv[0] = region->mapU(uv[0]);
+		uv[1] = region->mapV(uv[1]);
+	}
+	return true;
+}
+
+//---------- AtlasPacker ----------
+
+AtlasPacker::AtlasPacker(int width, int height)
+{
+	freeRects.push_back({ 0, 0, width, height });
+}
+
+bool AtlasPacker::insert(int width, int height, int &x, int &y)
+{
+	//The free rectangle leaving the smallest leftover on its shorter side
+	int bestShort = INT_MAX, bestLong = INT_MAX;
+	const Rect* best = nullptr;
+	for (const Rect &free : freeRects)
+	{
+		if (free.width < width || free.height < height)
+			continue;
+		const int leftoverX = free.width - width, leftoverY = free.height - height;
+		const int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+		if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+		{
+			bestShort = shortSide;
+			bestLong = longSide;
+			best = &free;
+		}
+	}
+	if (!best)
+		return false;
+	x = best->x;
+	y = best->y;
+	split({ x, y, width, height });
+	prune();
+	return true;
+}
+
+void AtlasPacker::split(const Rect &used)
+{
+	std::vector<Rect> next;
+	for (const Rect &free : freeRects)
+	{
+		if (used.x >= free.x + free.width || used.x + used.width <= free.x || used.y >= free.y + free.height || used.y + used.height <= free.y)
+		{
+			next.push_back(free);
+			continue;
+		}
+		//What is left of the free rectangle on each side of the used one
+		if (used.x > free.x)
+			next.push_back({ free.x, free.y, used.x - free.x, free.height });
+		if (used.x + used.width < free.x + free.width)
+			next.push_back({ used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height });
+		if (used.y > free.y)
+			next.push_back({ free.x, free.y, free.width, used.y - free.y });
+		if (used.y + used.height < free.y + free.height)
+			next.push_back({ free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height });
+	}
+	freeRects.swap(next);
+}
+
+void AtlasPacker::prune()
+{
+	//A free rectangle inside another one is redundant
+	for (std::size_t i = 0; i < freeRects.size(); ++i)
+		for (std::size_t j = 0; j < freeRects.size(); ++j)
+		{
+			if (i == j)
+				continue;
+			const Rect &a = freeRects[i], &b = freeRects[j];
+			if (a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height)
+			{
+				freeRects.erase(freeRects.begin() + i);
+				--i;
+				break;
+			}
+		}
+}
+
+//---------- TextureAtlas ----------
+
+TextureAtlas::TextureAtlas(int padding, int maxSize)
+	: padding(1), maxSize(maxSize)
+{
+	while (this->padding < padding)
+		this->padding *= 2;
+}
+
+void TextureAtlas::add(const std::string &name, const unsigned char* pixels, int width, int height, int channels)
+{
+	Image image;
+	image.name = name;
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	image.pixels.assign(pixels, pixels + (std::size_t)width * height * channels);
+	images.push_back(std::move(image));
+}
+
+bool TextureAtlas::pack(int width, int height, std::vector<int> &x, std::vector<int> &y) const
+{
+	//The packer works in units of the cell alignment, so no placement can break it
+	const int alignment = cellAlignment(padding);
+	std::vector<std::size_t> order(images.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	//Biggest first, the small ones fill the holes
+	std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+	{
+		return std::max(images[a].width, images[a].height) > std::max(images[b].width, images[b].height);
+	});
+
+	AtlasPacker packer(width / alignment, height / alignment);
+	x.assign(images.size(), 0);
+	y.assign(images.size(), 0);
+	for (std::size_t i : order)
+	{
+		const int cellWidth = cellSize(images[i].width, padding);
+		const int cellHeight = cellSize(images[i].height, padding);
+		if (!packer.insert(cellWidth / alignment, cellHeight / alignment, x[i], y[i]))
+			return false;
+		x[i] *= alignment;
+		y[i] *= alignment;
+	}
+	return true;
+}
+
+bool TextureAtlas::build()
+{
+	//Any multiple of the cell alignment rather than powers of two only, GL 3.3 samples and mipmaps any size :
+	//two 528 texel cells take 1056x528 instead of 2048x1024
+	//Each width is packed in a bin as high as allowed, the images then tell the height they need
+	//Like before, the sides stay within a factor 2 of each other
+	const int alignment = cellAlignment(padding);
+	const int limit = maxSize / alignment * alignment;
+	long long area = 0;
+	int widest = alignment, highest = alignment;
+	for (const Image &image : images)
+	{
+		const int cellWidth = cellSize(image.width, padding), cellHeight = cellSize(image.height, padding);
+		area += (long long)cellWidth * cellHeight;
+		widest = std::max(widest, cellWidth);
+		highest = std::max(highest, cellHeight);
+	}
+
+	long long bestArea = LLONG_MAX;
+	int bestWidth = 0, bestHeight = 0;
+	std::vector<int> x, y, bestX, bestY;
+	//A wider atlas is at least highest and half its width high : past bestArea nothing can be smaller
+	for (int width = widest; width <= limit && (long long)width * std::max(highest, width / 2) <= bestArea; width += alignment)
+	{
+		const int binHeight = std::min(limit, width * 2);
+		if ((long long)width * binHeight < area || !pack(width, binHeight, x, y))
+			continue;
+		int height = alignUp((width + 1) / 2, alignment);
+		for (std::size_t i = 0; i < images.size(); ++i)
+			height = std::max(height, y[i] + cellSize(images[i].height, padding));
+		//Same area : the squarer one, then the wider one
+		const long long candidate = (long long)width * height;
+		const int side = std::max(width, height), bestSide = std::max(bestWidth, bestHeight);
+		if (candidate < bestArea || (candidate == bestArea && (side < bestSide || (side == bestSide && width > bestWidth))))
+		{
+			bestArea = candidate;
+			bestWidth = width;
+			bestHeight = height;
+			bestX.swap(x);
+			bestY.swap(y);
+		}
+	}
+	if (bestWidth == 0)
+	{
+		std::cout << "ERROR::ATLAS::DOES_NOT_FIT in " << maxSize << "x" << maxSize << std::endl;
+		return false;
+	}
+	table.width = bestWidth;
+	table.height = bestHeight;
+	compose(bestX, bestY);
+	return true;
+}
+
+void TextureAtlas::compose(const std::vector<int> &x, const std::vector<int> &y)
+{
+	bool color = false, alpha = false;
+	for (const Image &image : images)
+	{
+		color = color || image.channels >= 3;
+		alpha = alpha || image.channels == 2 || image.channels == 4;
+	}
+	channels = color ? (alpha ? 4 : 3) : (alpha ? 2 : 1);
+	pixels.assign((std::size_t)table.width * table.height * channels, 0);
+	table.regions.clear();
+
+	for (std::size_t i = 0; i < images.size(); ++i)
+	{
+		const Image &image = images[i];
+		AtlasRegion region;
+		region.name = image.name;
+		region.x = x[i] + padding;
+		region.y = y[i] + padding;
+		region.width = image.width;
+		region.height = image.height;
+		region.u0 = (float)region.x / table.width;
+		region.v0 = (float)region.y / table.height;
+		region.u1 = (float)(region.x + region.width) / table.width;
+		region.v1 = (float)(region.y + region.height) / table.height;
+		table.regions.push_back(region);
+
+		//The gutter repeats the closest edge texel of the image, over the whole cell : the texels left
+		//after the gutter by the alignment must not darken the last mip levels
+		unsigned char rgba[4];
+		const int cellRight = x[i] + cellSize(image.width, padding), cellBottom = y[i] + cellSize(image.height, padding);
+		for (int atlasY = y[i]; atlasY < cellBottom; ++atlasY)
+		{
+			const int sourceY = std::min(std::max(atlasY - region.y, 0), image.height - 1);
+			for (int atlasX = x[i]; atlasX < cellRight; ++atlasX)
+			{
+				const int sourceX = std::min(std::max(atlasX - region.x, 0), image.width - 1);
+				readTexel(image.pixels.data() + ((std::size_t)sourceY * image.width + sourceX) * image.channels, image.channels, rgba);
+				writeTexel(rgba, channels, pixels.data() + ((std::size_t)atlasY * table.width + atlasX) * channels);
+			}
+		}
+	}
+}
+
+int TextureAtlas::getSafeLevelCount(bool blockCompressed, MipFilter filter) const
+{
+	//Texels of gutter around an image that only hold its own colors : the whole padding at level 0
+	//The box filter averages the 2x2 texels under each texel of the next level, that margin halves
+	//The 8 taps Kaiser filter also reads 3 texels past them on each side, the margin loses 3 before halving
+	//The bilinear filter of the last level needs 1 texel of margin. A 4x4 block holding the edge of an
+	//image reaches up to 3 texels past it : with the box filter the other colors only start on the edge
+	//of a cell, a multiple of the margin, 2 is enough. With the Kaiser filter they can start anywhere
+	const int required = !blockCompressed ? 1 : filter == MipFilter::Kaiser ? 3 : 2;
+	int margin = padding;
+	int levels = 1;
+	for (;;)
+	{
+		margin = filter == MipFilter::Kaiser ? (margin - 3) / 2 : margin / 2;
+		if (margin < required)
+			break;
+		++levels;
+	}
+	return levels;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "MipGenerator.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Many images in one texture : every quad samples the same texture, one bind for all of them
+//	- TextureAtlas packs the images (MaxRects) and composes the atlas, used by the TextureCooker
+//	- AtlasTable is the lookup table from an image name to its rectangle, written next to the atlas (.atlas)
+//	  and read by the samples to remap the UVs of their vertices
+
+//Rectangle of one image in the atlas, in texels, the gutter not included
+struct AtlasRegion
+{
+	std::string name;
+	int x, y, width, height;
+	//Same rectangle in UV
+	float u0, v0, u1, v1;
+
+	//UV of the image on its own ([0,1]) -> UV in the atlas
+	float mapU(float u) const { return u0 + u * (u1 - u0); }
+	float mapV(float v) const { return v0 + v * (v1 - v0); }
+};
+
+class AtlasTable
+{
+public:
+	bool load(const std::string &path);
+	//Same from the content of a .atlas file already in memory (asset pack...), name is only used by the error message
+	bool read(std::string_view text, const std::string &name);
+	bool save(const std::string &path) const;
+
+	//nullptr when the image is not in the atlas
+	const AtlasRegion* find(const std::string &name) const;
+	//Rewrites the UV pair at uvOffset of every vertex (offset and stride counted in floats)
+	//Returns false, leaving the vertices alone, when the image is not in the atlas
+	bool remapUVs(const std::string &name, float* vertices, int vertexCount, int stride, int uvOffset) const;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	const std::vector<AtlasRegion>& getRegions() const { return regions; }
+
+private:
+	friend class TextureAtlas;
+	int width = 0, height = 0;
+	std::vector<AtlasRegion> regions;
+};
+
+//MaxRects bin packing, best short side fit
+class AtlasPacker
+{
+public:
+	AtlasPacker(int width, int height);
+	//Position of a width x height rectangle, false when it does not fit anymore
+	bool insert(int width, int height, int &x, int &y);
+
+private:
+	struct Rect
+	{
+		int x, y, width, height;
+	};
+	//Maximal free rectangles, they overlap each other
+	std::vector<Rect> freeRects;
+
+	void split(const Rect &used);
+	void prune();
+};
+
+class TextureAtlas
+{
+public:
+	//padding : texels around every image filled with its edges, so that bilinear filtering and the
+	//first mips never reach the neighbour image. Rounded up to a power of two, the images start
+	//on multiples of it so that each level keeps the gutters aligned
+	TextureAtlas(int padding = 8, int maxSize = 4096);
+
+	//The pixels are copied, 1 to 4 channels like stbi_load returns them
+	void add(const std::string &name, const unsigned char* pixels, int width, int height, int channels);
+	//Smallest atlas holding every image, both sides multiples of the cell alignment (not powers of two)
+	//False when maxSize is not enough
+	bool build();
+
+	int getWidth() const { return table.width; }
+	int getHeight() const { return table.height; }
+	//Enough for every image : grey, grey alpha, RGB or RGBA
+	int getChannels() const { return channels; }
+	const std::vector<unsigned char>& getPixels() const { return pixels; }
+	const AtlasTable& getTable() const { return table; }
+	//Mip levels buildMipChain can make with that filter without reaching past the gutters
+	//The Kaiser filter reaches further than the box one, it keeps less levels for the same padding
+	//Block compression also needs the 4x4 blocks at the edge of each image to stay inside its gutter
+	int getSafeLevelCount(bool blockCompressed, MipFilter filter) const;
+
+private:
+	struct Image
+	{
+		std::string name;
+		int width, height, channels;
+		std::vector<unsigned char> pixels;
+	};
+	std::vector<Image> images;
+	int padding;
+	int maxSize;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+	AtlasTable table;
+
+	bool pack(int width, int height, std::vector<int> &x, std::vector<int> &y) const;
+	void compose(const std::vector<int> &x, const std::vector<int> &y);
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "TextureResidency.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "MipGenerator.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	bool hasTextureStorage()
+	{
+		return hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_storage");
+	}
+
+	bool hasCopyImage()
+	{
+		return hasGLVersion(4, 3) || hasGLExtension("GL_ARB_copy_image");
+	}
+
+	//Levels of a source, read from a cooked texture or decoded from an image
+	struct SourceLevels
+	{
+		CookedTexture cooked;
+		unsigned char* pixels = nullptr;
+		std::vector<MipLevel> mips;
+		std::vector<const void*> data;
+
+		~SourceLevels()
+		{
+			stbi_image_free(pixels);
+		}
+	};
+}
+
+std::size_t TextureResidency::Entry::levelsSize(unsigned int first) const
+{
+	std::size_t size = 0;
+	for (unsigned int level = first; level < levelCount; ++level)
+		size += cookedLevelSize(internalFormat, std::max(1, width >> level), std::max(1, height >> level));
+	return size;
+}
+
+TextureResidency::TextureResidency(std::size_t budget, unsigned int maxDroppedLevels)
+	: budget(budget), maxDroppedLevels(maxDroppedLevels)
+{
+}
+
+TextureResidency::~TextureResidency()
+{
+	for (Entry &entry : entries)
+		release(entry);
+}
+
+unsigned int TextureResidency::add(const std::string &path)
+{
+	Entry entry;
+	entry.path = path;
+	return add(std::move(entry));
+}
+
+unsigned int TextureResidency::add(const AssetPack &pack, const std::string &name)
+{
+	Entry entry;
+	entry.path = name;
+	entry.pack = &pack;
+	return add(std::move(entry));
+}
+
+unsigned int TextureResidency::add(Entry entry)
+{
+	entries.push_back(std::move(entry));
+	//0 is never a handle, like for the GL objects
+	return (unsigned int)entries.size();
+}
+
+unsigned int TextureResidency::use(unsigned int handle)
+{
+	Entry &entry = entries[handle - 1];
+	entry.lastUse = frame;
+	if (entry.texture && entry.firstLevel == 0)
+		return entry.texture;
+	if (entry.failed)
+		return 0;
+
+	//Never loaded, evicted or trimmed : back at full size, the others make room first
+	const bool reload = entry.loadedOnce;
+	release(entry);
+	trim(entry.levelsSize(0));
+	if (!load(entry, 0))
+	{
+		entry.failed = true;
+		return 0;
+	}
+	if (reload)
+		++stats.reloads;
+	return entry.texture;
+}
+
+void TextureResidency::endFrame()
+{
+	trim(0);
+	++frame;
+}
+
+void TextureResidency::setBudget(std::size_t bytes)
+{
+	budget = bytes;
+}
+
+bool TextureResidency::isResident(unsigned int handle) const
+{
+	return entries[handle - 1].texture != 0;
+}
+
+unsigned int TextureResidency::getDroppedLevels(unsigned int handle) const
+{
+	return entries[handle - 1].firstLevel;
+}
+
+void TextureResidency::trim(std::size_t incoming)
+{
+	while (residentBytes + incoming > budget)
+	{
+		Entry* oldest = nullptr;
+		for (Entry &entry : entries)
+			if (entry.texture && entry.lastUse < frame && (!oldest || entry.lastUse < oldest->lastUse))
+				oldest = &entry;
+		//Everything in VRAM is used by this frame
+		if (!oldest)
+			return;
+
+		if (oldest->firstLevel < maxDroppedLevels && oldest->firstLevel + 1 < oldest->levelCount && dropTopLevel(*oldest))
+			++stats.droppedLevels;
+		else
+		{
+			release(*oldest);
+			++stats.evictions;
+		}
+	}
+}
+
+bool TextureResidency::load(Entry &entry, unsigned int first)
+{
+	SourceLevels source;
+	if (entry.pack || CookedTexture::isCookedPath(entry.path))
+	{
+		//Cooked : the levels are read from the mapping, nothing is decoded
+		const bool opened = entry.pack ? entry.pack->getTexture(entry.path, source.cooked) : source.cooked.open(entry.path);
+		if (!opened)
+			return false;
+		if (!source.cooked.isSupported())
+		{
+			std::cout << "ERROR::TEXTURE::COOKED::FORMAT_NOT_SUPPORTED " << std::hex << source.cooked.getHeader().internalFormat << std::dec << " " << entry.path << std::endl;
+			return false;
+		}
+		const CookedTextureHeader &header = source.cooked.getHeader();
+		entry.internalFormat = header.internalFormat;
+		entry.format = header.format;
+		entry.type = header.type;
+		entry.width = header.width;
+		entry.height = header.height;
+		entry.levelCount = header.levelCount;
+		for (unsigned int level = 0; level < entry.levelCount; ++level)
+			source.data.push_back(source.cooked.getLevelData(level));
+	}
+	else
+	{
+		int channels;
+		source.pixels = stbi_load(entry.path.c_str(), &entry.width, &entry.height, &channels, 0);
+		if (!source.pixels)
+		{
+			std::cout << "Failed to load texture " << entry.path << std::endl;
+			return false;
+		}
+		entry.type = GL_UNSIGNED_BYTE;
+		switch (channels)
+		{
+		case 1: entry.internalFormat = GL_R8; entry.format = GL_RED; break;
+		case 2: entry.internalFormat = GL_RG8; entry.format = GL_RG; break;
+		case 3: entry.internalFormat = GL_RGB8; entry.format = GL_RGB; break;
+		default: entry.internalFormat = GL_RGBA8; entry.format = GL_RGBA; break;
+		}
+		source.mips = buildMipChain(source.pixels, entry.width, entry.height, channels);
+		source.data.push_back(source.pixels);
+		for (const MipLevel &mip : source.mips)
+			source.data.push_back(mip.pixels.data());
+		entry.levelCount = (unsigned int)source.data.size();
+	}
+	first = std::min(first, entry.levelCount - 1);
+
+	release(entry);
+	entry.texture = createTexture(entry, first);
+	//The levels come from client memory, not from a pixel unpack buffer
+	GLStateCache::get().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLint previousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = first; level < entry.levelCount; ++level)
+	{
+		const GLint target = (GLint)(level - first);
+		const GLsizei width = std::max(1, entry.width >> level), height = std::max(1, entry.height >> level);
+		const std::size_t size = cookedLevelSize(entry.internalFormat, width, height);
+		if (entry.format == 0)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, width, height, entry.internalFormat, (GLsizei)size, source.data[level]);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, width, height, entry.format, entry.type, source.data[level]);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+	entry.firstLevel = first;
+	entry.bytes = entry.levelsSize(first);
+	entry.loadedOnce = true;
+	residentBytes += entry.bytes;
+	return true;
+}
+
+bool TextureResidency::dropTopLevel(Entry &entry)
+{
+	const unsigned int first = entry.firstLevel + 1;
+	//Without copies between textures the source is read again, its top levels skipped
+	if (!hasCopyImage())
+		return load(entry, first);
+
+	const unsigned int texture = createTexture(entry, first);
+	for (unsigned int level = first; level < entry.levelCount; ++level)
+	{
+		const GLsizei width = std::max(1, entry.width >> level), height = std::max(1, entry.height >> level);
+		glCopyImageSubData(entry.texture, GL_TEXTURE_2D, level - entry.firstLevel, 0, 0, 0, texture, GL_TEXTURE_2D, level - first, 0, 0, 0, width, height, 1);
+	}
+	release(entry);
+	entry.texture = texture;
+	entry.firstLevel = first;
+	entry.bytes = entry.levelsSize(first);
+	residentBytes += entry.bytes;
+	return true;
+}
+
+void TextureResidency::release(Entry &entry)
+{
+	if (!entry.texture)
+		return;
+	GLStateCache::get().forgetTexture(entry.texture);
+	glDeleteTextures(1, &entry.texture);
+	entry.texture = 0;
+	residentBytes -= entry.bytes;
+	entry.bytes = 0;
+	entry.firstLevel = 0;
+}
+
+unsigned int TextureResidency::createTexture(const Entry &entry, unsigned int first) const
+{
+	const GLsizei levelCount = (GLsizei)(entry.levelCount - first);
+	const GLsizei width = std::max(1, entry.width >> first), height = std::max(1, entry.height >> first);
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLStateCache &state = GLStateCache::get();
+	state.bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	if (hasTextureStorage())
+	{
+		glTexStorage2D(GL_TEXTURE_2D, levelCount, entry.internalFormat, width, height);
+		return texture;
+	}
+	//Null data must not be read as an offset in a pixel unpack buffer
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	for (GLsizei level = 0; level < levelCount; ++level)
+	{
+		const GLsizei levelWidth = std::max(1, width >> level), levelHeight = std::max(1, height >> level);
+		if (entry.format == 0)
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, levelWidth, levelHeight, 0, (GLsizei)cookedLevelSize(entry.internalFormat, levelWidth, levelHeight), nullptr);
+		else
+			glTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, levelWidth, levelHeight, 0, entry.format, entry.type, nullptr);
+	}
+	return texture;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <glad/glad.h>
+#include "AssetPack.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Keeps the textures in VRAM under a byte budget :
+//	- every texture is registered with its source and only loaded on its first use()
+//	- its size is estimated from its format, the whole mip chain included
+//	- at the end of the frame, while the budget is exceeded, the least recently used texture
+//	  first loses its top mip levels (each one is 3/4 of the texture), then is deleted
+//	- a texture used again is reloaded at full size from its source (.ctex, asset pack or image)
+//The textures used during the current frame are never trimmed : the budget may be exceeded by them alone
+class TextureResidency
+{
+public:
+	struct Stats
+	{
+		//Textures loaded again after an eviction or a trim
+		unsigned int reloads = 0;
+		unsigned int evictions = 0;
+		//Top mip levels dropped
+		unsigned int droppedLevels = 0;
+	};
+
+	//maxDroppedLevels : top levels a texture may lose before it is evicted
+	TextureResidency(std::size_t budget = 256 << 20, unsigned int maxDroppedLevels = 2);
+	~TextureResidency();
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+
+	//Handle of the texture, nothing is read yet
+	//path : cooked texture (.ctex) or image read by stb_image, its mips are built by buildMipChain
+	unsigned int add(const std::string &path);
+	//Cooked texture of an asset pack, the pack must stay open while the texture is registered
+	unsigned int add(const AssetPack &pack, const std::string &name);
+
+	//GL texture to bind for this draw, loaded at full size when it was evicted or trimmed
+	//The name changes after a reload : never keep it from one frame to the next
+	//0 when the source can't be read
+	unsigned int use(unsigned int handle);
+	//Call once per frame, after the draws : trims the textures until they fit in the budget
+	void endFrame();
+
+	void setBudget(std::size_t bytes);
+	std::size_t getBudget() const { return budget; }
+	//Estimated bytes of every texture in VRAM
+	std::size_t getResidentBytes() const { return residentBytes; }
+	bool isResident(unsigned int handle) const;
+	//Levels dropped from the top of the texture, 0 at full size
+	unsigned int getDroppedLevels(unsigned int handle) const;
+	const Stats& getStats() const { return stats; }
+
+private:
+	struct Entry
+	{
+		//Name in the pack when pack is set
+		std::string path;
+		const AssetPack* pack = nullptr;
+		unsigned int texture = 0;
+		//Known once the source was read
+		GLenum internalFormat = 0;
+		//Both 0 for a compressed format
+		GLenum format = 0, type = 0;
+		int width = 0, height = 0;
+		unsigned int levelCount = 0;
+		//Top levels missing from the texture
+		unsigned int firstLevel = 0;
+		std::size_t bytes = 0;
+		//Frame of the last use(), 0 when never used
+		std::uint64_t lastUse = 0;
+		bool loadedOnce = false;
+		bool failed = false;
+
+		std::size_t levelsSize(unsigned int first) const;
+	};
+
+	std::vector<Entry> entries;
+	std::size_t budget;
+	std::size_t residentBytes = 0;
+	unsigned int maxDroppedLevels;
+	std::uint64_t frame = 1;
+	Stats stats;
+
+	unsigned int add(Entry entry);
+	//Reads the source and uploads its levels from first
+	bool load(Entry &entry, unsigned int first);
+	//Same texture without its top level, its other levels copied on the GPU
+	bool dropTopLevel(Entry &entry);
+	void release(Entry &entry);
+	//Empty storage for the levels from first
+	unsigned int createTexture(const Entry &entry, unsigned int first) const;
+	//Trim until incoming more bytes fit in the budget
+	void trim(std::size_t incoming);
+};
+
+#endif
@@ -0,0 +1,380 @@
+#include "TextureStreamer.h"
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "ImageArena.h"
+#include "stb_image.h"
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	GLenum formatOf(int channels)
+	{
+		switch (channels)
+		{
+		case 1: return GL_RED;
+		case 2: return GL_RG;
+		case 3: return GL_RGB;
+		default: return GL_RGBA;
+		}
+	}
+
+	//Each upload starts on a 16 bytes boundary of the ring
+	std::size_t alignRing(std::size_t size)
+	{
+		return (size + 15) & ~(std::size_t)15;
+	}
+}
+
+TextureStreamer::TextureStreamer(unsigned int workerCount, std::size_t ringSize, std::size_t frameBudget)
+	: pool(workerCount), frameBudget(frameBudget), ringSize(ringSize)
+{
+	GLStateCache &state = GLStateCache::get();
+	glGenBuffers(1, &ringBuffer);
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+	//GL 4.4 / ARB_buffer_storage -> mapped once for the whole life of the streamer
+	ringPersistent = hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage");
+	if (ringPersistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSize, NULL, flags);
+		ringMemory = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSize, flags);
+		ringPersistent = ringMemory != nullptr;
+	}
+	if (!ringPersistent)
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, ringSize, NULL, GL_STREAM_DRAW);
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	//Workers may still be writing into decoded
+	pool.wait();
+	for (InFlight &region : inFlight)
+		glDeleteSync(region.fence);
+
+	GLStateCache &state = GLStateCache::get();
+	if (ringPersistent)
+	{
+		state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	state.forgetBuffer(ringBuffer);
+	glDeleteBuffers(1, &ringBuffer);
+}
+
+unsigned int TextureStreamer::createTexture()
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, texture);
+	//Set the texture wrapping
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	//Set texture filtering parameters, begin() switches to a mipmap min filter once the level count is known
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//Placeholder until the real image is uploaded
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+	textures[texture] = -1;
+	++pending;
+	return texture;
+}
+
+unsigned int TextureStreamer::load(const std::string &path, bool mipmaps)
+{
+	const unsigned int texture = createTexture();
+	pool.submit([this, texture, path, mipmaps, options = mipOptions] { decode(texture, path, mipmaps, options); });
+	return texture;
+}
+
+unsigned int TextureStreamer::load(const AssetPack &pack, const std::string &name)
+{
+	const unsigned int texture = createTexture();
+	Decoded image;
+	image.texture = texture;
+	image.mipmaps = true;
+	//Only the header of the payload is read, the levels are copied into the ring by update()
+	image.cooked.reset(new CookedTexture());
+	if (!pack.getTexture(name, *image.cooked))
+		image.cooked.reset();
+
+	std::lock_guard<std::mutex> lock(decodedMutex);
+	decoded.push_back(std::move(image));
+	return texture;
+}
+
+unsigned int TextureStreamer::Decoded::levelCount() const
+{
+	if (cooked)
+		return cooked->getLevelCount();
+	return pixels.empty() ? 0 : 1 + (unsigned int)mips.size();
+}
+
+const void* TextureStreamer::Decoded::levelData(unsigned int level) const
+{
+	if (cooked)
+		return cooked->getLevelData(level);
+	return level == 0 ? pixels.data() : mips[level - 1].pixels.data();
+}
+
+std::size_t TextureStreamer::Decoded::levelSize(unsigned int level) const
+{
+	if (cooked)
+		return cooked->getLevelSize(level);
+	return level == 0 ? (std::size_t)width * height * channels : mips[level - 1].pixels.size();
+}
+
+void TextureStreamer::decode(unsigned int texture, const std::string &path, bool mipmaps, const MipOptions &options)
+{
+	Decoded image;
+	image.texture = texture;
+	image.mipmaps = mipmaps;
+	if (CookedTexture::isCookedPath(path))
+	{
+		//Nothing to decode : the levels are read from the mapping when they are uploaded
+		image.cooked.reset(new CookedTexture());
+		if (!image.cooked->open(path))
+			image.cooked.reset();
+	}
+	else
+	{
+		unsigned char* pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+		if (!pixels)
+			std::cout << "Failed to load texture " << path << std::endl;
+		else
+		{
+			if (mipmaps)
+				image.mips = buildMipChain(pixels, image.width, image.height, image.channels, options);
+			//Out of the arena before the job ends, it can then start again from its beginning for the next image
+			image.pixels.assign(pixels, pixels + (std::size_t)image.width * image.height * image.channels);
+			stbi_image_free(pixels);
+		}
+	}
+	//The zlib / JPEG buffers stb used are free by now
+	ImageArena::endBatch();
+
+	std::lock_guard<std::mutex> lock(decodedMutex);
+	decoded.push_back(std::move(image));
+}
+
+void TextureStreamer::retireRing()
+{
+	//Regions are freed in the order they were written, stop at the first one the GPU still reads
+	while (!inFlight.empty())
+	{
+		const GLenum result = glClientWaitSync(inFlight.front().fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			break;
+		glDeleteSync(inFlight.front().fence);
+		ringUsed -= inFlight.front().size;
+		inFlight.pop_front();
+	}
+	//Nothing in flight : the next region starts at the beginning, a level as big as the ring still fits
+	if (inFlight.empty())
+		ringHead = ringUsed = 0;
+}
+
+bool TextureStreamer::fitsInRing(std::size_t size) const
+{
+	size = alignRing(size);
+	//An image never wraps around the end of the ring, the end is skipped instead
+	const std::size_t skipped = ringHead + size > ringSize ? ringSize - ringHead : 0;
+	return size <= ringSize && ringUsed + skipped + size <= ringSize;
+}
+
+bool TextureStreamer::allocateRing(std::size_t size, std::size_t &offset)
+{
+	if (!fitsInRing(size))
+		return false;
+	size = alignRing(size);
+	const std::size_t skipped = ringHead + size > ringSize ? ringSize - ringHead : 0;
+
+	offset = (ringHead + skipped) % ringSize;
+	ringHead = offset + size;
+	ringUsed += skipped + size;
+	frameRingBytes += skipped + size;
+	return true;
+}
+
+void TextureStreamer::stageLevels(std::vector<const void*> &levels, const std::vector<std::size_t> &sizes)
+{
+	GLStateCache &state = GLStateCache::get();
+	std::size_t size = 0;
+	for (std::size_t levelSize : sizes)
+		size += levelSize;
+	std::size_t offset = 0;
+	if (!allocateRing(size, offset))
+	{
+		//Bigger than the whole ring : uploaded from where the levels are
+		state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return;
+	}
+
+	//The whole chain goes into one region of the ring, one level after the other
+	state.bindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+	//Without a persistent mapping, the fences already guarantee that the GPU is done with this range
+	unsigned char* memory = ringPersistent ? ringMemory + offset
+		: (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	for (std::size_t level = 0; level < levels.size(); ++level)
+	{
+		std::memcpy(memory, levels[level], sizes[level]);
+		memory += sizes[level];
+		//With a pixel unpack buffer bound, the image data given to glTex(Sub)Image2D is an offset in that buffer
+		levels[level] = (const void*)offset;
+		offset += sizes[level];
+	}
+	if (!ringPersistent)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+}
+
+bool TextureStreamer::begin(const Decoded &image)
+{
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, image.texture);
+	if (image.cooked)
+	{
+		//The mip chain was made by the cooker
+		const CookedTexture &cooked = *image.cooked;
+		if (!cooked.isSupported())
+		{
+			std::cout << "ERROR::TEXTURE::COOKED::FORMAT_NOT_SUPPORTED " << std::hex << cooked.getHeader().internalFormat << std::dec << std::endl;
+			return false;
+		}
+		//Storage of every level at once, they are filled smallest first
+		cooked.allocate();
+	}
+	else
+	{
+		//The mip levels were built by the worker (buildMipChain), no glGenerateMipmap
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levelCount() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	}
+	return true;
+}
+
+void TextureStreamer::uploadLevel(const Decoded &image, int level)
+{
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, image.texture);
+	std::vector<const void*> levels(1, image.levelData(level));
+	std::vector<std::size_t> sizes(1, image.levelSize(level));
+	stageLevels(levels, sizes);
+	if (image.cooked)
+		image.cooked->uploadLevel(level, levels[0]);
+	else
+	{
+		const GLenum format = formatOf(image.channels);
+		const int width = level == 0 ? image.width : image.mips[level - 1].width;
+		const int height = level == 0 ? image.height : image.mips[level - 1].height;
+		//glTexImage2D(texture target,mipmap level, format we want to store the texture, width, height,always 0,format,datatype,image data)
+		glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, levels[0]);
+	}
+	//Sampling starts at the biggest level uploaded so far, the ones above are still empty
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+}
+
+unsigned int TextureStreamer::update()
+{
+	if (pending == 0)
+		return 0;
+	retireRing();
+
+	//Rows of 1 or 3 channels images are not always 4 bytes aligned
+	GLint previousAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	//Every decoded image is streamed from now on, the ones that failed keep their placeholder
+	std::deque<Decoded> arrived;
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		arrived.swap(decoded);
+	}
+	for (Decoded &image : arrived)
+	{
+		if (image.levelCount() == 0)
+		{
+			--pending;
+			continue;
+		}
+		Streaming texture;
+		texture.nextLevel = (int)image.levelCount() - 1;
+		texture.started = false;
+		texture.image = std::move(image);
+		streaming.push_back(std::move(texture));
+	}
+
+	unsigned int ready = 0;
+	std::size_t uploaded = 0;
+	while (!streaming.empty())
+	{
+		//Smallest level waiting first : every texture shows its small levels before any gets its big ones,
+		//so the first frames stay as fast whatever the size of the images
+		std::size_t next = 0;
+		for (std::size_t i = 1; i < streaming.size(); ++i)
+			if (streaming[i].image.levelSize(streaming[i].nextLevel) < streaming[next].image.levelSize(streaming[next].nextLevel))
+				next = i;
+		Streaming &texture = streaming[next];
+		const std::size_t size = texture.image.levelSize(texture.nextLevel);
+		//Always upload at least one level per frame, even a big one
+		if (uploaded > 0 && uploaded + size > frameBudget)
+			break;
+		//No room left in the ring : wait for the GPU to release a region in a next frame
+		if (size <= ringSize && !fitsInRing(size))
+			break;
+		//The storage is only made with the first level : the placeholder stays until there is something to show
+		if (!texture.started && !begin(texture.image))
+		{
+			streaming.erase(streaming.begin() + next);
+			--pending;
+			continue;
+		}
+		texture.started = true;
+		uploadLevel(texture.image, texture.nextLevel);
+		textures[texture.image.texture] = texture.nextLevel;
+		uploaded += size;
+		if (--texture.nextLevel < 0)
+		{
+			streaming.erase(streaming.begin() + next);
+			--pending;
+			++ready;
+		}
+	}
+
+	GLStateCache::get().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+	if (frameRingBytes > 0)
+	{
+		inFlight.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frameRingBytes });
+		frameRingBytes = 0;
+	}
+	return ready;
+}
+
+bool TextureStreamer::isReady(unsigned int texture) const
+{
+	return getBaseLevel(texture) == 0;
+}
+
+int TextureStreamer::getBaseLevel(unsigned int texture) const
+{
+	auto it = textures.find(texture);
+	return it == textures.end() ? -1 : it->second;
+}
+
+bool TextureStreamer::isIdle() const
+{
+	return pending == 0;
+}
+
+void TextureStreamer::setFrameBudget(std::size_t bytes)
+{
+	frameBudget = bytes;
+}
+
+void TextureStreamer::setMipOptions(const MipOptions &options)
+{
+	mipOptions = options;
+}
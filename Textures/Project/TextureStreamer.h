@@ -0,0 +1,127 @@
+#pragma once
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include "AssetPack.h"
+#include "CookedTexture.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Asynchronous texture loading :
+//	- the images are decoded by a pool of worker threads (stbi_load)
+//	  their mip levels are built there too (buildMipChain), not by glGenerateMipmap
+//	  cooked textures (.ctex) are only mapped, their levels are copied as they are
+//	- the pixels are copied into a ring of pixel unpack buffer, persistently mapped when the driver allows it
+//	- update() uploads from the ring on the GL thread, within a byte budget per frame
+//	  one mip level at a time, the smallest first : GL_TEXTURE_BASE_LEVEL follows the biggest level uploaded,
+//	  so a texture shows a blurry version of itself after a frame and gets sharper over the next ones
+//load() returns the texture at once, it shows a 1x1 placeholder until its first level is uploaded
+//The destructor deletes the ring, its mapping and its fences : destroy the streamer while its context
+//is still current, before glfwTerminate()
+class TextureStreamer
+{
+public:
+	//0 workers -> one per core minus the render thread
+	TextureStreamer(unsigned int workerCount = 0, std::size_t ringSize = 32 << 20, std::size_t frameBudget = 8 << 20);
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	//Texture usable right away (GL_REPEAT, GL_LINEAR), the image is decoded in background
+	unsigned int load(const std::string &path, bool mipmaps = true);
+	//Cooked texture of an asset pack : nothing to open nor decode, it goes straight to the upload queue
+	//The levels are read from the mapping of the pack, it must stay open until the texture is ready
+	unsigned int load(const AssetPack &pack, const std::string &name);
+	//Call once per frame from the GL thread : uploads what has been decoded, up to the frame budget
+	//Returns the number of textures that became ready
+	unsigned int update();
+
+	//True once every level is uploaded
+	bool isReady(unsigned int texture) const;
+	//Biggest level the texture shows (0 when ready), -1 while it shows the placeholder
+	int getBaseLevel(unsigned int texture) const;
+	//True when nothing is decoding or waiting for upload
+	bool isIdle() const;
+	void setFrameBudget(std::size_t bytes);
+	//Filter of the mip levels built for the next load() calls
+	void setMipOptions(const MipOptions &options);
+
+private:
+	struct Decoded
+	{
+		unsigned int texture;
+		//Copied out of the ImageArena of the worker, the upload may take many frames
+		std::vector<unsigned char> pixels;
+		int width, height, channels;
+		bool mipmaps;
+		//Levels 1 and more of pixels
+		std::vector<MipLevel> mips;
+		//Set instead of pixels for a .ctex file
+		std::unique_ptr<CookedTexture> cooked;
+
+		//Level 0 is pixels (or the cooked level 0), then the mips
+		unsigned int levelCount() const;
+		const void* levelData(unsigned int level) const;
+		std::size_t levelSize(unsigned int level) const;
+	};
+	//Decoded texture whose levels are being uploaded, over several frames
+	struct Streaming
+	{
+		Decoded image;
+		//Next level to upload, the smaller ones are already in the texture
+		int nextLevel;
+		//Storage made, see begin()
+		bool started;
+	};
+	//Region of the ring written during one frame, reusable once its fence is signaled
+	struct InFlight
+	{
+		GLsync fence;
+		std::size_t size;
+	};
+
+	ThreadPool pool;
+	std::size_t frameBudget;
+	MipOptions mipOptions;
+
+	//Filled by the workers, emptied by update()
+	mutable std::mutex decodedMutex;
+	std::deque<Decoded> decoded;
+	//Only touched by the GL thread
+	std::vector<Streaming> streaming;
+	//texture -> base level, see getBaseLevel()
+	std::unordered_map<unsigned int, int> textures;
+	unsigned int pending = 0;
+
+	unsigned int ringBuffer = 0;
+	unsigned char* ringMemory = nullptr;
+	bool ringPersistent = false;
+	std::size_t ringSize;
+	std::size_t ringHead = 0;
+	std::size_t ringUsed = 0;
+	std::size_t frameRingBytes = 0;
+	std::deque<InFlight> inFlight;
+
+	//Placeholder texture, registered as not ready
+	unsigned int createTexture();
+	void decode(unsigned int texture, const std::string &path, bool mipmaps, const MipOptions &options);
+	bool fitsInRing(std::size_t size) const;
+	bool allocateRing(std::size_t size, std::size_t &offset);
+	void retireRing();
+	//Copies the levels one after the other into the ring and turns their pointers into offsets in it
+	//The ring is left bound, or nothing when the levels do not fit in it
+	void stageLevels(std::vector<const void*> &levels, const std::vector<std::size_t> &sizes);
+	//Storage of the texture, right before its first level, false when it keeps its placeholder
+	bool begin(const Decoded &image);
+	void uploadLevel(const Decoded &image, int level);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+	if (workerCount == 0)
+	{
+		const unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+	for (unsigned int i = 0; i < workerCount; ++i)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobAvailable.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobsDone.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+unsigned int ThreadPool::getWorkerCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+void ThreadPool::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (stopping)
+			return;
+		std::function<void()> job = std::move(jobs.front());
+		jobs.pop_front();
+		++running;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		--running;
+		if (jobs.empty() && running == 0)
+			jobsDone.notify_all();
+	}
+}
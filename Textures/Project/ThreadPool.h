@@ -0,0 +1,41 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed set of worker threads running jobs in submission order
+//Jobs must not touch GL : only the thread owning the context can
+class ThreadPool
+{
+public:
+	//0 -> one worker per core, minus the one running the render loop
+	ThreadPool(unsigned int workerCount = 0);
+	//Waits for the running jobs, the queued ones are dropped
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> job);
+	//Block until every submitted job has run
+	void wait();
+	unsigned int getWorkerCount() const;
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsDone;
+	unsigned int running = 0;
+	bool stopping = false;
+
+	void workerLoop();
+};
+
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+//Types to describe a uniform block as a C++ struct with the std140 layout
+//Scalars are float, std::int32_t and std::uint32_t (a GLSL bool is 4 bytes -> use std140::boolean)
+namespace std140
+{
+	typedef std::uint32_t boolean;
+
+	struct alignas(8) vec2 { float x, y; };
+	//Aligned on 16 but only 12 bytes long in std140 : a scalar may follow in the same slot
+	//No alignas here, so C++ keeps that packing -> STD140_NEXT asks for padding when it is misplaced
+	struct vec3 { float x, y, z; };
+	struct alignas(16) vec4 { float x, y, z, w; };
+	struct alignas(8) ivec2 { std::int32_t x, y; };
+	struct alignas(16) ivec4 { std::int32_t x, y, z, w; };
+	//Matrices are column major, each column takes a vec4 slot
+	struct alignas(16) mat3 { vec4 columns[3]; };
+	struct alignas(16) mat4 { vec4 columns[4]; };
+
+	//Each element of an array is rounded up to a vec4 slot
+	template<typename T>
+	struct alignas(16) element { T value; };
+	template<typename T, std::size_t N>
+	struct alignas(16) array { element<T> elements[N]; T& operator[](std::size_t i) { return elements[i].value; } };
+
+	//Base alignment and size of each type according to the std140 rules
+	template<typename T> struct traits;
+	template<> struct traits<float> { static constexpr std::size_t alignment = 4, size = 4; };
+	template<> struct traits<std::int32_t> { static constexpr std::size_t alignment = 4, size = 4; };
+	template<> struct traits<std::uint32_t> { static constexpr std::size_t alignment = 4, size = 4; };
+	template<> struct traits<vec2> { static constexpr std::size_t alignment = 8, size = 8; };
+	template<> struct traits<ivec2> { static constexpr std::size_t alignment = 8, size = 8; };
+	template<> struct traits<vec3> { static constexpr std::size_t alignment = 16, size = 12; };
+	template<> struct traits<vec4> { static constexpr std::size_t alignment = 16, size = 16; };
+	template<> struct traits<ivec4> { static constexpr std::size_t alignment = 16, size = 16; };
+	template<> struct traits<mat3> { static constexpr std::size_t alignment = 16, size = 48; };
+	template<> struct traits<mat4> { static constexpr std::size_t alignment = 16, size = 64; };
+	//The stride of an array is its element rounded up to a vec4 slot : 16 for a float, 64 for a mat4
+	template<typename T, std::size_t N> struct traits<array<T, N>> { static constexpr std::size_t alignment = 16, size = sizeof(element<T>) * N; };
+
+	constexpr std::size_t alignUp(std::size_t offset, std::size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	//Offset std140 gives to a member of type T placed after a member of type Previous
+	template<typename Previous, typename T>
+	constexpr std::size_t nextOffset(std::size_t previousOffset)
+	{
+		return alignUp(previousOffset + traits<Previous>::size, traits<T>::alignment);
+	}
+}
+
+//Compile time layout checks, one line per member in declaration order :
+//	struct Camera { std140::mat4 view; std140::mat4 projection; float time; };
+//	STD140_FIRST(Camera, view);
+//	STD140_NEXT(Camera, view, projection);
+//	STD140_NEXT(Camera, projection, time);
+#define STD140_MEMBER_TYPE(Block, member) std::remove_cv_t<std::remove_reference_t<decltype(std::declval<Block&>().member)>>
+#define STD140_FIRST(Block, member) \
+	static_assert(offsetof(Block, member) == 0, #Block "::" #member " must be the first member of the block")
+#define STD140_NEXT(Block, previous, member) \
+	static_assert(offsetof(Block, member) == std140::nextOffset<STD140_MEMBER_TYPE(Block, previous), STD140_MEMBER_TYPE(Block, member)>(offsetof(Block, previous)), \
+		#Block "::" #member " is not at its std140 offset, reorder the members or add padding")
+
+//Checks of the rules above, on a block mixing arrays of every slot count
+namespace std140
+{
+	struct LayoutCheck
+	{
+		mat4 model;
+		array<mat4, 4> bones;
+		array<mat3, 2> normals;
+		array<float, 3> weights;
+		vec3 tint;
+		float time;
+	};
+	STD140_FIRST(LayoutCheck, model);
+	STD140_NEXT(LayoutCheck, model, bones);
+	STD140_NEXT(LayoutCheck, bones, normals);
+	STD140_NEXT(LayoutCheck, normals, weights);
+	STD140_NEXT(LayoutCheck, weights, tint);
+	STD140_NEXT(LayoutCheck, tint, time);
+	static_assert(offsetof(LayoutCheck, time) == 476, "std140::LayoutCheck : time is at 476 in GLSL");
+}
+
+//GPU copy of a uniform block, uploaded in one call and shared by every program through its binding point
+//Programs are connected to the binding point with Shader::bindUniformBlock
+template<typename Block>
+class UniformBuffer
+{
+public:
+	static_assert(std::is_standard_layout<Block>::value, "A uniform block must be a standard layout struct");
+	static_assert(std::is_trivially_copyable<Block>::value, "A uniform block must be trivially copyable");
+
+	//Buffer ID
+	unsigned int ID;
+
+	UniformBuffer(unsigned int binding)
+		: binding(binding)
+	{
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		//The driver rounds the block size up to a vec4
+		glBufferData(GL_UNIFORM_BUFFER, std140::alignUp(sizeof(Block), 16), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+	}
+	~UniformBuffer()
+	{
+		glDeleteBuffers(1, &ID);
+	}
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	//Whole block in one driver call
+	void update(const Block &data)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	unsigned int getBinding() const
+	{
+		return binding;
+	}
+
+private:
+	unsigned int binding;
+};
+
+#endif
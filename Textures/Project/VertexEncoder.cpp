@@ -0,0 +1,410 @@
+#include "VertexEncoder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VERTEX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+//MSVC accepts the intrinsics of any instruction set in any function
+#define VERTEX_SSE2_TARGET
+#define VERTEX_F16C_TARGET
+#else
+#include <cpuid.h>
+//GCC and clang only emit them in functions compiled for that target
+#define VERTEX_SSE2_TARGET __attribute__((target("sse2")))
+#define VERTEX_F16C_TARGET __attribute__((target("sse2,f16c")))
+#endif
+#endif
+
+namespace
+{
+	const float* sourceAt(const float* source, std::size_t stride, std::size_t i)
+	{
+		return (const float*)((const unsigned char*)source + i * stride);
+	}
+
+	template<typename T>
+	T* destinationAt(void* destination, std::size_t stride, std::size_t i)
+	{
+		return (T*)((unsigned char*)destination + i * stride);
+	}
+
+	//Normalized integers : a value v is stored as round(clamp(v, low, 1) * scale)
+	struct NormFormat
+	{
+		float scale;
+		float low;
+	};
+	const NormFormat unorm8 = { 255.0f, 0.0f };
+	const NormFormat unorm16 = { 65535.0f, 0.0f };
+	const NormFormat snorm16 = { 32767.0f, -1.0f };
+
+	//Rounds to nearest even like _mm_cvtps_epi32 : both paths give the same values
+	template<typename T>
+	void quantizeScalar(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count, NormFormat format)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			T* out = destinationAt<T>(destination, destinationStride, i);
+			for (int c = 0; c < components; ++c)
+				out[c] = (T)std::nearbyint(std::min(std::max(in[c], format.low), 1.0f) * format.scale);
+		}
+	}
+
+	void halfScalar(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			std::uint16_t* out = destinationAt<std::uint16_t>(destination, destinationStride, i);
+			for (int c = 0; c < components; ++c)
+				out[c] = floatToHalf(in[c]);
+		}
+	}
+
+	//Unit vector -> point of the octahedron |x| + |y| + |z| = 1, the lower half folded over the upper one
+	void octahedralScalar(float x, float y, float z, std::int16_t* out)
+	{
+		const float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+		float u = 0.0f, v = 0.0f;
+		if (length > 0.0f)
+		{
+			u = x / length;
+			v = y / length;
+			if (z < 0.0f)
+			{
+				const float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+				const float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+				u = foldedU;
+				v = foldedV;
+			}
+		}
+		out[0] = (std::int16_t)std::nearbyint(std::min(std::max(u, -1.0f), 1.0f) * snorm16.scale);
+		out[1] = (std::int16_t)std::nearbyint(std::min(std::max(v, -1.0f), 1.0f) * snorm16.scale);
+	}
+
+	void octahedralDecode(const std::int16_t* in, double* normal)
+	{
+		const double u = std::max(in[0] / 32767.0, -1.0), v = std::max(in[1] / 32767.0, -1.0);
+		normal[0] = u;
+		normal[1] = v;
+		normal[2] = 1.0 - std::fabs(u) - std::fabs(v);
+		if (normal[2] < 0.0)
+		{
+			normal[0] = (1.0 - std::fabs(v)) * (u >= 0.0 ? 1.0 : -1.0);
+			normal[1] = (1.0 - std::fabs(u)) * (v >= 0.0 ? 1.0 : -1.0);
+		}
+	}
+
+#ifdef VERTEX_X86
+	//One vertex per register, the components past `components` are ignored
+	template<typename T>
+	VERTEX_SSE2_TARGET void quantizeSSE2(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count, NormFormat format)
+	{
+		const __m128 low = _mm_set1_ps(format.low), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(format.scale);
+		alignas(16) float lanes[4] = {};
+		alignas(16) std::int32_t values[4];
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			T* out = destinationAt<T>(destination, destinationStride, i);
+			std::memcpy(lanes, in, components * sizeof(float));
+			const __m128 value = _mm_min_ps(_mm_max_ps(_mm_load_ps(lanes), low), one);
+			_mm_store_si128((__m128i*)values, _mm_cvtps_epi32(_mm_mul_ps(value, scale)));
+			for (int c = 0; c < components; ++c)
+				out[c] = (T)values[c];
+		}
+	}
+
+	VERTEX_F16C_TARGET void halfF16C(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+	{
+		alignas(16) float lanes[4] = {};
+		alignas(16) std::uint16_t values[8];
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::memcpy(lanes, sourceAt(source, sourceStride, i), components * sizeof(float));
+			_mm_store_si128((__m128i*)values, _mm_cvtps_ph(_mm_load_ps(lanes), _MM_FROUND_TO_NEAREST_INT));
+			std::memcpy(destinationAt<std::uint16_t>(destination, destinationStride, i), values, components * sizeof(std::uint16_t));
+		}
+	}
+
+	//Four normals per register, one register per axis
+	VERTEX_SSE2_TARGET void octahedralSSE2(const float* source, std::size_t sourceStride, void* destination, std::size_t destinationStride, std::size_t count)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f), scale = _mm_set1_ps(snorm16.scale);
+		alignas(16) std::int32_t u[4], v[4];
+		std::size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const float* n0 = sourceAt(source, sourceStride, i);
+			const float* n1 = sourceAt(source, sourceStride, i + 1);
+			const float* n2 = sourceAt(source, sourceStride, i + 2);
+			const float* n3 = sourceAt(source, sourceStride, i + 3);
+			const __m128 x = _mm_setr_ps(n0[0], n1[0], n2[0], n3[0]);
+			const __m128 y = _mm_setr_ps(n0[1], n1[1], n2[1], n3[1]);
+			const __m128 z = _mm_setr_ps(n0[2], n1[2], n2[2], n3[2]);
+
+			const __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+			//Null normals stay at 0, 0 (+Z) instead of dividing by 0
+			const __m128 valid = _mm_cmpgt_ps(length, zero);
+			const __m128 safeLength = _mm_or_ps(_mm_and_ps(valid, length), _mm_andnot_ps(valid, one));
+			const __m128 pu = _mm_and_ps(valid, _mm_div_ps(x, safeLength));
+			const __m128 pv = _mm_and_ps(valid, _mm_div_ps(y, safeLength));
+
+			//Sign of >= 0 is +1 : -1 only where the value is below 0
+			const __m128 signU = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(pu, zero), minusOne), _mm_andnot_ps(_mm_cmplt_ps(pu, zero), one));
+			const __m128 signV = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(pv, zero), minusOne), _mm_andnot_ps(_mm_cmplt_ps(pv, zero), one));
+			const __m128 foldedU = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, pv)), signU);
+			const __m128 foldedV = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, pu)), signV);
+			const __m128 lower = _mm_and_ps(valid, _mm_cmplt_ps(z, zero));
+			const __m128 eu = _mm_or_ps(_mm_and_ps(lower, foldedU), _mm_andnot_ps(lower, pu));
+			const __m128 ev = _mm_or_ps(_mm_and_ps(lower, foldedV), _mm_andnot_ps(lower, pv));
+
+			_mm_store_si128((__m128i*)u, _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(eu, minusOne), one), scale)));
+			_mm_store_si128((__m128i*)v, _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ev, minusOne), one), scale)));
+			for (int k = 0; k < 4; ++k)
+			{
+				std::int16_t* out = destinationAt<std::int16_t>(destination, destinationStride, i + k);
+				out[0] = (std::int16_t)u[k];
+				out[1] = (std::int16_t)v[k];
+			}
+		}
+		for (; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			octahedralScalar(in[0], in[1], in[2], destinationAt<std::int16_t>(destination, destinationStride, i));
+		}
+	}
+
+	bool cpuHasSSE2()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return true;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	bool cpuHasF16C()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		//VEX encoded : the OS must also save the AVX registers
+		const bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		return osSavesAVX && (info[2] & (1 << 29));
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		return __builtin_cpu_supports("avx") && (ecx & bit_F16C);
+#endif
+	}
+#endif
+
+	bool useSSE2()
+	{
+#ifdef VERTEX_X86
+		static const bool supported = cpuHasSSE2();
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	bool useF16C()
+	{
+#ifdef VERTEX_X86
+		static const bool supported = cpuHasF16C();
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	//What the GPU reads back from a normalized integer, GL 4.2 rules (-32768 is -1 like -32767)
+	template<typename T>
+	AttributeError measureNorm(const float* source, std::size_t sourceStride, int components, const void* destination, std::size_t destinationStride, std::size_t count, NormFormat format)
+	{
+		AttributeError error;
+		//Half a step, and the rounding of the float product before it is rounded to an integer
+		error.bound = 0.5f / format.scale + std::numeric_limits<float>::epsilon();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			const T* out = destinationAt<const T>(const_cast<void*>(destination), destinationStride, i);
+			for (int c = 0; c < components; ++c)
+			{
+				const double decoded = std::max(out[c] / (double)format.scale, -1.0);
+				error.maxError = std::max(error.maxError, (float)std::fabs(decoded - in[c]));
+			}
+		}
+		return error;
+	}
+
+	template<typename T>
+	AttributeError encodeNorm(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count, NormFormat format)
+	{
+		components = std::min(std::max(components, 1), 4);
+#ifdef VERTEX_X86
+		if (useSSE2())
+			quantizeSSE2<T>(source, sourceStride, components, destination, destinationStride, count, format);
+		else
+#endif
+			quantizeScalar<T>(source, sourceStride, components, destination, destinationStride, count, format);
+		return measureNorm<T>(source, sourceStride, components, destination, destinationStride, count, format);
+	}
+}
+
+std::uint16_t floatToHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const std::uint16_t sign = (std::uint16_t)((bits >> 16) & 0x8000);
+	bits &= 0x7FFFFFFF;
+
+	//Infinity, and NaN kept a NaN
+	if (bits >= 0x7F800000)
+		return sign | 0x7C00 | (bits > 0x7F800000 ? 0x200 : 0);
+	//65520 and more round up past the largest half (65504)
+	if (bits >= 0x477FF000)
+		return sign | 0x7C00;
+
+	std::uint32_t half, rest, halfway;
+	if (bits < 0x38800000)
+	{
+		//Below 2^-14 : denormal half, counted in steps of 2^-24
+		const std::uint32_t exponent = bits >> 23;
+		if (exponent < 102)
+			return sign;
+		const std::uint32_t mantissa = (bits & 0x7FFFFF) | 0x800000;
+		const std::uint32_t shift = 126 - exponent;
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		//Exponent rebiased from 127 to 15, 13 bits of mantissa dropped
+		half = (bits - 0x38000000) >> 13;
+		rest = bits & 0x1FFF;
+		halfway = 0x1000;
+	}
+	//Round to nearest even like F16C, a carry into the exponent is still the right half
+	if (rest > halfway || (rest == halfway && (half & 1)))
+		++half;
+	return sign | (std::uint16_t)half;
+}
+
+float halfToFloat(std::uint16_t half)
+{
+	const std::uint32_t sign = (std::uint32_t)(half & 0x8000) << 16;
+	const std::uint32_t exponent = (half >> 10) & 0x1F;
+	std::uint32_t mantissa = half & 0x3FF;
+	std::uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		//Denormal half : normalized for the float
+		std::uint32_t shift = 0;
+		while (!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			++shift;
+		}
+		bits = sign | ((113 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+AttributeError encodeHalf(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+{
+	components = std::min(std::max(components, 1), 4);
+#ifdef VERTEX_X86
+	if (useF16C())
+		halfF16C(source, sourceStride, components, destination, destinationStride, count);
+	else
+#endif
+		halfScalar(source, sourceStride, components, destination, destinationStride, count);
+
+	AttributeError error;
+	float largest = 0.0f;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const float* in = sourceAt(source, sourceStride, i);
+		const std::uint16_t* out = destinationAt<std::uint16_t>(destination, destinationStride, i);
+		for (int c = 0; c < components; ++c)
+		{
+			largest = std::max(largest, std::fabs(in[c]));
+			error.maxError = std::max(error.maxError, (float)std::fabs((double)halfToFloat(out[c]) - in[c]));
+		}
+	}
+	//Half a step of 11 significant bits at the largest value, the denormal step near 0
+	error.bound = std::max(std::ldexp(largest, -11), std::ldexp(1.0f, -25));
+	return error;
+}
+
+AttributeError encodeUnorm8(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeNorm<std::uint8_t>(source, sourceStride, components, destination, destinationStride, count, unorm8);
+}
+
+AttributeError encodeUnorm16(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeNorm<std::uint16_t>(source, sourceStride, components, destination, destinationStride, count, unorm16);
+}
+
+AttributeError encodeSnorm16(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeNorm<std::int16_t>(source, sourceStride, components, destination, destinationStride, count, snorm16);
+}
+
+AttributeError encodeOctahedral(const float* source, std::size_t sourceStride, void* destination, std::size_t destinationStride, std::size_t count)
+{
+#ifdef VERTEX_X86
+	if (useSSE2())
+		octahedralSSE2(source, sourceStride, destination, destinationStride, count);
+	else
+#endif
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const float* in = sourceAt(source, sourceStride, i);
+			octahedralScalar(in[0], in[1], in[2], destinationAt<std::int16_t>(destination, destinationStride, i));
+		}
+
+	//Angle between each normal and its decoded direction
+	AttributeError error;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const float* in = sourceAt(source, sourceStride, i);
+		double normal[3];
+		octahedralDecode(destinationAt<std::int16_t>(destination, destinationStride, i), normal);
+		const double crossX = in[1] * normal[2] - in[2] * normal[1];
+		const double crossY = in[2] * normal[0] - in[0] * normal[2];
+		const double crossZ = in[0] * normal[1] - in[1] * normal[0];
+		const double dot = in[0] * normal[0] + in[1] * normal[1] + in[2] * normal[2];
+		if (in[0] != 0.0f || in[1] != 0.0f || in[2] != 0.0f)
+			error.maxError = std::max(error.maxError, (float)std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot));
+	}
+	//Half a step h on both axes moves the point of the octahedron by up to sqrt(6) h (z takes both),
+	//the sphere is at most sqrt(3) times farther than the octahedron (center of a face) : 3 sqrt(2) h
+	error.bound = 3.0f * std::sqrt(2.0f) * 0.5f / snorm16.scale + std::numeric_limits<float>::epsilon();
+	return error;
+}
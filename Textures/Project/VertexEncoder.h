@@ -0,0 +1,82 @@
+#pragma once
+#ifndef VERTEX_ENCODER_H
+#define VERTEX_ENCODER_H
+
+#include "VertexLayout.h"
+#include <cstddef>
+#include <cstdint>
+
+//Converts float vertex streams to the packed types of VertexLayout.h, to read fewer bytes per vertex
+//	- half      : positions and UVs outside [0, 1], 11 significant bits
+//	- unorm8    : colors, 1/255 steps
+//	- unorm16   : UVs in [0, 1], 1/65535 steps
+//	- snorm16   : signed values in [-1, 1]
+//	- octahedral: unit normals folded on an octahedron, 2 snorm16 instead of 3 floats
+//Each stream is read and written with a stride in bytes, so the attributes of interleaved vertices
+//are converted in place in their structs. One vertex is one SSE register (F16C for the halves)
+//when the CPU has it, the scalar path gives the same bytes
+//Decoding is left to GL : VertexFormat sets the type and the normalization from the packed member,
+//except for the octahedral normals that the vertex shader unfolds (octahedralDecode below)
+
+//How much an attribute lost, both in the unit of the attribute (radians for the normals)
+struct AttributeError
+{
+	//Largest difference between a source value and what the GPU reads back
+	float maxError = 0.0f;
+	//Largest difference the format gives for values in its range
+	//maxError above it : some values were out of range and clamped
+	float bound = 0.0f;
+
+	bool withinBound() const { return maxError <= bound; }
+};
+
+std::uint16_t floatToHalf(float value);
+float halfToFloat(std::uint16_t bits);
+
+//source : count vertices of `components` floats (1 to 4), sourceStride bytes apart
+//destination : count vertices of `components` values, destinationStride bytes apart
+AttributeError encodeHalf(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count);
+AttributeError encodeUnorm8(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count);
+AttributeError encodeUnorm16(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count);
+AttributeError encodeSnorm16(const float* source, std::size_t sourceStride, int components, void* destination, std::size_t destinationStride, std::size_t count);
+//source : 3 floats per normal, need not be normalized (a null normal gives +Z)
+//destination : 2 snorm16 per normal, vertex::oct16
+//The GLSL to unfold them :
+//	vec3 octahedralDecode(vec2 e)
+//	{
+//		vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//		if (n.z < 0.0)
+//			n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+//		return normalize(n);
+//	}
+AttributeError encodeOctahedral(const float* source, std::size_t sourceStride, void* destination, std::size_t destinationStride, std::size_t count);
+
+//The encoder is picked from the packed member, its component count included :
+//	encodeAttribute(&vertices[0].uv.v[0], sizeof(Vertex), &packed[0].uv, sizeof(PackedVertex), count);
+template<int N>
+AttributeError encodeAttribute(const float* source, std::size_t sourceStride, vertex::vec<vertex::half, N>* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeHalf(source, sourceStride, N, destination, destinationStride, count);
+}
+template<int N>
+AttributeError encodeAttribute(const float* source, std::size_t sourceStride, vertex::norm<std::uint8_t, N>* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeUnorm8(source, sourceStride, N, destination, destinationStride, count);
+}
+template<int N>
+AttributeError encodeAttribute(const float* source, std::size_t sourceStride, vertex::norm<std::uint16_t, N>* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeUnorm16(source, sourceStride, N, destination, destinationStride, count);
+}
+template<int N>
+AttributeError encodeAttribute(const float* source, std::size_t sourceStride, vertex::norm<std::int16_t, N>* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeSnorm16(source, sourceStride, N, destination, destinationStride, count);
+}
+//source : 3 floats per normal, not 2 like a snorm16x2
+inline AttributeError encodeAttribute(const float* source, std::size_t sourceStride, vertex::oct16* destination, std::size_t destinationStride, std::size_t count)
+{
+	return encodeOctahedral(source, sourceStride, destination, destinationStride, count);
+}
+
+#endif
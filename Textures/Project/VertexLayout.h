@@ -0,0 +1,155 @@
+#pragma once
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+#include "GLStateCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+//Types to describe a vertex as a C++ struct, each member being one attribute
+//The GL type, the component count and the normalization come from the type of the member :
+//	- vec<T, N>  : converted to float as is (a 3 in a byte gives 3.0)
+//	- norm<T, N> : unsigned -> [0, 1], signed -> [-1, 1] (a 255 in a byte gives 1.0)
+//	- ivec<T, N> : read as an integer by the shader (ivec / uvec inputs), through glVertexAttribIPointer
+//VertexEncoder.h fills the packed types from float streams
+namespace vertex
+{
+	//16 bits float, its bits as written by encodeHalf
+	struct half { std::uint16_t bits; };
+
+	template<typename T, int N> struct vec { T v[N]; };
+	template<typename T, int N> struct norm { T v[N]; };
+	template<typename T, int N> struct ivec { T v[N]; };
+
+	typedef vec<float, 2> vec2;
+	typedef vec<float, 3> vec3;
+	typedef vec<float, 4> vec4;
+	typedef vec<half, 2> half2;
+	typedef vec<half, 3> half3;
+	typedef vec<half, 4> half4;
+	typedef norm<std::uint8_t, 3> unorm8x3;
+	typedef norm<std::uint8_t, 4> unorm8x4;
+	typedef norm<std::int8_t, 4> snorm8x4;
+	typedef norm<std::uint16_t, 2> unorm16x2;
+	typedef norm<std::int16_t, 2> snorm16x2;
+	typedef norm<std::int16_t, 4> snorm16x4;
+	//Unit vector folded on an octahedron, see encodeOctahedral
+	//Read by GL like a snorm16x2, its own type so that encodeAttribute picks the octahedral encoder
+	struct oct16 { std::int16_t v[2]; };
+
+	//GL enum of a component type
+	template<typename T> struct component;
+	template<> struct component<float> { static constexpr GLenum type = GL_FLOAT; };
+	template<> struct component<half> { static constexpr GLenum type = GL_HALF_FLOAT; };
+	template<> struct component<std::int8_t> { static constexpr GLenum type = GL_BYTE; };
+	template<> struct component<std::uint8_t> { static constexpr GLenum type = GL_UNSIGNED_BYTE; };
+	template<> struct component<std::int16_t> { static constexpr GLenum type = GL_SHORT; };
+	template<> struct component<std::uint16_t> { static constexpr GLenum type = GL_UNSIGNED_SHORT; };
+	template<> struct component<std::int32_t> { static constexpr GLenum type = GL_INT; };
+	template<> struct component<std::uint32_t> { static constexpr GLenum type = GL_UNSIGNED_INT; };
+
+	//How GL reads an attribute of each type
+	template<typename T> struct traits;
+	template<typename T, int N> struct traits<vec<T, N>>
+	{
+		static constexpr GLenum type = component<T>::type;
+		static constexpr GLint components = N;
+		static constexpr bool normalized = false, integer = false;
+	};
+	template<typename T, int N> struct traits<norm<T, N>>
+	{
+		static_assert(std::is_integral<T>::value, "Only integer components are normalized");
+		static constexpr GLenum type = component<T>::type;
+		static constexpr GLint components = N;
+		static constexpr bool normalized = true, integer = false;
+	};
+	template<typename T, int N> struct traits<ivec<T, N>>
+	{
+		static_assert(std::is_integral<T>::value, "An integer attribute needs integer components");
+		static constexpr GLenum type = component<T>::type;
+		static constexpr GLint components = N;
+		static constexpr bool normalized = false, integer = true;
+	};
+	//A lone scalar is a 1 component vector
+	template<> struct traits<float> : traits<vec<float, 1>> {};
+	template<> struct traits<std::int32_t> : traits<ivec<std::int32_t, 1>> {};
+	template<> struct traits<std::uint32_t> : traits<ivec<std::uint32_t, 1>> {};
+	template<> struct traits<oct16> : traits<norm<std::int16_t, 2>> {};
+
+	//One member of the vertex : the shader location it feeds and where it is in the struct
+	template<GLuint Location, std::size_t Offset, typename T>
+	struct attribute
+	{
+		static_assert(traits<T>::components >= 1 && traits<T>::components <= 4, "An attribute has 1 to 4 components");
+		//GL wants each attribute on a 4 bytes boundary
+		static_assert(Offset % 4 == 0, "An attribute must start on a 4 bytes boundary, add padding before it");
+
+		static constexpr GLuint location = Location;
+		static constexpr std::size_t offset = Offset;
+		static constexpr std::size_t size = sizeof(T);
+		typedef vertex::traits<T> info;
+	};
+
+	template<typename... Attributes>
+	constexpr bool uniqueLocations()
+	{
+		const GLuint locations[] = { Attributes::location... };
+		for (std::size_t i = 0; i < sizeof...(Attributes); ++i)
+			for (std::size_t j = i + 1; j < sizeof...(Attributes); ++j)
+				if (locations[i] == locations[j])
+					return false;
+		return true;
+	}
+}
+
+//One line per member of the vertex :
+//	struct Vertex { vertex::vec3 position; vertex::unorm8x4 color; };
+//	typedef VertexFormat<Vertex, VERTEX_ATTRIBUTE(Vertex, 0, position), VERTEX_ATTRIBUTE(Vertex, 1, color)> Format;
+//	Format::apply(VAO, VBO, EBO);
+#define VERTEX_MEMBER_TYPE(Vertex, member) std::remove_cv_t<std::remove_reference_t<decltype(std::declval<Vertex&>().member)>>
+#define VERTEX_ATTRIBUTE(Vertex, location, member) vertex::attribute<location, offsetof(Vertex, member), VERTEX_MEMBER_TYPE(Vertex, member)>
+
+//Attribute pointers of an interleaved vertex buffer, the stride and the offsets taken from the struct
+//Shader::validateVertexLayout still checks the result against the inputs of the program
+template<typename Vertex, typename... Attributes>
+class VertexFormat
+{
+public:
+	static_assert(std::is_standard_layout<Vertex>::value, "A vertex must be a standard layout struct (offsetof)");
+	static_assert(std::is_trivially_copyable<Vertex>::value, "A vertex must be trivially copyable");
+	static_assert(sizeof...(Attributes) > 0, "A vertex format needs at least one attribute");
+	static_assert(vertex::uniqueLocations<Attributes...>(), "Two attributes use the same location");
+	static_assert(((Attributes::offset + Attributes::size <= sizeof(Vertex)) && ...), "An attribute ends past the vertex");
+
+	static constexpr GLsizei stride = (GLsizei)sizeof(Vertex);
+	static constexpr std::size_t attributeCount = sizeof...(Attributes);
+
+	//Records the attributes and the buffers in vao, which stays bound
+	//ebo : 0 to leave the element buffer of the VAO alone
+	static void apply(unsigned int vao, unsigned int vbo, unsigned int ebo = 0)
+	{
+		GLStateCache &state = GLStateCache::get();
+		state.bindVertexArray(vao);
+		state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+		if (ebo)
+			state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		(pointer<Attributes>(), ...);
+	}
+
+private:
+	template<typename Attribute>
+	static void pointer()
+	{
+		typedef typename Attribute::info traits;
+		if (traits::integer)
+			glVertexAttribIPointer(Attribute::location, traits::components, traits::type, stride, (void*)Attribute::offset);
+		else
+			glVertexAttribPointer(Attribute::location, traits::components, traits::type, traits::normalized ? GL_TRUE : GL_FALSE, stride, (void*)Attribute::offset);
+		glEnableVertexAttribArray(Attribute::location);
+	}
+};
+
+#endif
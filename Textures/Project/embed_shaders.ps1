@@ -0,0 +1,48 @@
+# Pre-build step : embeds shader files into EmbeddedShaders.h as constexpr char arrays
+# Each file gives an EmbeddedShader named after it (vShader.vs -> embedded::vShader_vs)
+# whose hash is computed by the compiler with Shader::hashSource
+# The header is only rewritten when its content changes, so unchanged shaders don't trigger a rebuild
+#	powershell -NoProfile -ExecutionPolicy Bypass -File embed_shaders.ps1 -OutFile EmbeddedShaders.h vShader.vs fShader.fs
+param(
+	[Parameter(Mandatory = $true)][string]$OutFile,
+	[Parameter(Mandatory = $true, ValueFromRemainingArguments = $true)][string[]]$Files
+)
+$ErrorActionPreference = "Stop"
+# Paths are relative to the project folder, like the ones used at runtime
+Push-Location $PSScriptRoot
+try
+{
+	$builder = New-Object System.Text.StringBuilder
+	[void]$builder.Append("//Generated by embed_shaders.ps1 from the shader files, do not edit`n")
+	[void]$builder.Append("#pragma once`n")
+	[void]$builder.Append("#ifndef EMBEDDED_SHADERS_H`n#define EMBEDDED_SHADERS_H`n`n")
+	[void]$builder.Append("#include `"Shader.h`"`n`n")
+	[void]$builder.Append("namespace embedded`n{`n")
+	foreach ($file in $Files)
+	{
+		$bytes = [System.IO.File]::ReadAllBytes((Join-Path $PSScriptRoot $file))
+		$name = $file -replace '[^A-Za-z0-9]', '_'
+		$path = $file -replace '\\', '/'
+		[void]$builder.Append("`tconstexpr char ${name}_data[] = {`n")
+		for ($i = 0; $i -lt $bytes.Length; $i += 16)
+		{
+			$last = [Math]::Min($i + 15, $bytes.Length - 1)
+			$line = ($bytes[$i..$last] | ForEach-Object { "'\x{0:x2}'," -f $_ }) -join " "
+			[void]$builder.Append("`t`t$line`n")
+		}
+		[void]$builder.Append("`t`t'\0' };`n")
+		[void]$builder.Append("`tconstexpr EmbeddedShader $name = { `"$path`", std::string_view(${name}_data, $($bytes.Length)), Shader::hashSource(std::string_view(${name}_data, $($bytes.Length))) };`n`n")
+	}
+	[void]$builder.Append("}`n`n#endif`n")
+
+	$content = $builder.ToString()
+	$target = Join-Path $PSScriptRoot $OutFile
+	if (!(Test-Path $target) -or ([System.IO.File]::ReadAllText($target) -ne $content))
+	{
+		[System.IO.File]::WriteAllText($target, $content)
+	}
+}
+finally
+{
+	Pop-Location
+}
@@ -3,14 +3,26 @@ out vec4 FragColor;
 
 in vec3 vertex_color;
 in vec2 TexCoord;
+in vec2 TexCoord2;
 
+#ifdef TEXTURE_ARRAY
+//Variant for the MaterialTable : every material of the same size and format is a layer of one array,
+//the draws switch material without binding anything
+uniform sampler2DArray materials;
+flat in vec2 Layers;
+#else
 uniform sampler2D texture1;
 uniform sampler2D texture2;
+#endif
 //Here we don't have to assign a location value to tehe texture sampler2D
 //We have only one texture so the program render the square with that texture
 //-> default texture
 
 void main()
 {
-	FragColor = mix(texture(texture1,TexCoord), texture(texture2,TexCoord),0.3);
+#ifdef TEXTURE_ARRAY
+	FragColor = mix(texture(materials,vec3(TexCoord,Layers.x)), texture(materials,vec3(TexCoord2,Layers.y)),0.3);
+#else
+	FragColor = mix(texture(texture1,TexCoord), texture(texture2,TexCoord2),0.3);
+#endif
 };
\ No newline at end of file
@@ -1,11 +1,53 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "AssetPack.h"
+#include "GLStateCache.h"
+#include "ImageArena.h"
+#include "MeshOptimizer.h"
 #include "Shader.h"
+#include "TextureAtlas.h"
+#include "TextureStreamer.h"
+#include "VertexEncoder.h"
+#include "VertexLayout.h"
+#ifdef EMBED_SHADERS
+#include "EmbeddedShaders.h"
+#else
+#include "ShaderWatcher.h"
+#endif
+//The workers of the TextureStreamer decode into their own arena, no malloc lock shared between them
+#define STBI_MALLOC(size) ImageArena::allocate(size)
+#define STBI_REALLOC(pointer, size) ImageArena::reallocate(pointer, size)
+#define STBI_FREE(pointer) ImageArena::release(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 
+//Vertex of the quad as it is written, in floats
+struct QuadVertex
+{
+	vertex::vec3 position;
+	vertex::vec3 color;
+	vertex::vec2 texCoord;
+	vertex::vec2 texCoord2;
+};
+//What the GPU reads for locations 0 to 3 of vShader.vs : 20 bytes instead of 40
+//The UVs stay in [0, 1] after remapUVs, unorm16 is finer than any atlas texel
+struct PackedQuadVertex
+{
+	vertex::half3 position;
+	std::uint16_t padding0;
+	vertex::unorm8x3 color;
+	std::uint8_t padding1;
+	vertex::unorm16x2 texCoord;
+	vertex::unorm16x2 texCoord2;
+};
+typedef VertexFormat<PackedQuadVertex,
+	VERTEX_ATTRIBUTE(PackedQuadVertex, 0, position),
+	VERTEX_ATTRIBUTE(PackedQuadVertex, 1, color),
+	VERTEX_ATTRIBUTE(PackedQuadVertex, 2, texCoord),
+	VERTEX_ATTRIBUTE(PackedQuadVertex, 3, texCoord2)> QuadFormat;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 
@@ -35,133 +77,139 @@ int main()
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-	Shader shader("vShader.vs", "fShader.fs");
-
-
-	float vertices[] = {
-		// positions          // colors           // texture coords
-		 0.5f,  0.5f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f,   // top right
-		 0.5f, -0.5f, 0.0f,   0.0f, 1.0f, 0.0f,   1.0f, 0.0f,   // bottom right
-		-0.5f, -0.5f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f,   // bottom left
-		-0.5f,  0.5f, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f    // top left 
-	};
-
-	unsigned int indices[] = {
-		0, 1, 3, // first triangle
-		1, 2, 3  // second triangle
-	};
-
-
-	unsigned int VAO, VBO, EBO;
-	glGenBuffers(1, &VBO);
-	glGenVertexArrays(1, &VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBindVertexArray(VAO);
-	glGenBuffers(1, &EBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3* sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	shader.use();
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-
-	unsigned int texture1, texture2;
-//Texture 1
-	glGenTextures(1, &texture1);
-	//Texture Units
-	//Allow us to use more than 1 textures in our shaders
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	//Set the texture wrapping 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	//Set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//load and generate the texture
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
-
-	//The texture is now bound, we can start generating a texture using the previously loaded
-	//image data
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		//glTexImage2D(texture target,mipmap level, format we want to store the texture, width, height,always 0,format,datatype,image data)
-		//		-> once texImage is called, the currently bound texture object now has the texture image attached to it
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
+	//Every bind goes through the cache so that the ones changing nothing never reach the driver
+	GLStateCache &state = GLStateCache::get();
+	//Everything owning GL objects lives in this scope : their destructors call GL,
+	//they must run while the context still exists, before glfwTerminate()
 	{
-		std::cout << "Failed to load texture " << std::endl;
-	}
+#ifdef EMBED_SHADERS
+		//Release : the shaders are compiled into the executable, nothing is read from the working directory
+		Shader shader(embedded::vShader_vs, embedded::fShader_fs);
+#else
+		Shader shader("vShader.vs", "fShader.fs");
+		//Rebuild the program when vShader.vs or fShader.fs are saved
+		ShaderWatcher shaderWatcher(shader);
+#endif
+
+
+		QuadVertex vertices[] = {
+			// positions             // colors              // texture coords  // texture coords 2
+			{ {  0.5f,  0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f },    { 1.0f, 1.0f } },   // top right
+			{ {  0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f },    { 1.0f, 0.0f } },   // bottom right
+			{ { -0.5f, -0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f },    { 0.0f, 0.0f } },   // bottom left
+			{ { -0.5f,  0.5f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f },    { 0.0f, 1.0f } }    // top left 
+		};
+
+		//The cooked assets are gathered in assets.pack before the build (TextureCooker -pack) :
+		//one file mapped at startup, each asset is a hash lookup in it, no open per asset
+		AssetPack assets;
+		assets.open("assets.pack");
+
+		//container.jpg and awesomeface.png are packed in one atlas (textures.ctex) before the build
+		//textures.atlas tells where each image landed : the UVs above go from the whole image to its rectangle
+		AtlasTable atlas;
+		atlas.read(assets.getData("textures.atlas"), "textures.atlas");
+		atlas.remapUVs("container.jpg", (float*)vertices, 4, sizeof(QuadVertex) / sizeof(float), offsetof(QuadVertex, texCoord) / sizeof(float));
+		atlas.remapUVs("awesomeface.png", (float*)vertices, 4, sizeof(QuadVertex) / sizeof(float), offsetof(QuadVertex, texCoord2) / sizeof(float));
+
+		unsigned int indices[] = {
+			0, 1, 3, // first triangle
+			1, 2, 3  // second triangle
+		};
+		//Triangles in post-transform cache order, then the vertices renumbered in the order they are first used
+		optimizeVertexCache(indices, indices, 6, 4);
+		remapVertices(vertices, 4, optimizeVertexFetch(indices, 6, 4));
+
+		PackedQuadVertex packed[4] = {};
+		const char* attributeNames[] = { "position", "color", "texCoord", "texCoord2" };
+		const AttributeError errors[] = {
+			encodeAttribute(&vertices[0].position.v[0], sizeof(QuadVertex), &packed[0].position, sizeof(PackedQuadVertex), 4),
+			encodeAttribute(&vertices[0].color.v[0], sizeof(QuadVertex), &packed[0].color, sizeof(PackedQuadVertex), 4),
+			encodeAttribute(&vertices[0].texCoord.v[0], sizeof(QuadVertex), &packed[0].texCoord, sizeof(PackedQuadVertex), 4),
+			encodeAttribute(&vertices[0].texCoord2.v[0], sizeof(QuadVertex), &packed[0].texCoord2, sizeof(PackedQuadVertex), 4)
+		};
+		for (int i = 0; i < 4; ++i)
+			if (!errors[i].withinBound())
+				std::cout << "ERROR::VERTEX::OUT_OF_RANGE " << attributeNames[i] << " error " << errors[i].maxError << " > " << errors[i].bound << std::endl;
+
+
+		unsigned int VAO, VBO, EBO;
+		glGenBuffers(1, &VBO);
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &EBO);
+		//Binds the VAO with its buffers and sets the attribute pointers from PackedQuadVertex
+		QuadFormat::apply(VAO, VBO, EBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(packed), packed, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-	stbi_image_free(data);
-
-//Texture 2
-	glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	// set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	// set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	data = stbi_load("awesomeface.png", &width, &height, &nrChannels, 0);
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-	{
-		std::cout << "Failed to load texture 2" << std::endl;
-	}
+		shader.use();
 
-	//it is good practice to free the image memory
-	stbi_image_free(data);
+		state.bindBuffer(GL_ARRAY_BUFFER, 0);
+		state.bindVertexArray(0);
+		//Make sure the attribute pointers above match the inputs of vShader.vs
+		shader.validateVertexLayout(VAO);
 
-	shader.use();
-	shader.setInt("texture1", 0);
-	shader.setInt("texture2", 1);
 
+		//The texture is uploaded by textureStreamer.update() in the render loop, its smallest mip level first :
+		//it shows a placeholder, then a blurry version that gets sharper over the next frames
+		//textures.ctex is cooked from container.jpg and awesomeface.png before the build (TextureCooker -flip -bc -atlas),
+		//its mip levels are ready : no stbi_load, no glGenerateMipmap
+		//It stays block compressed in VRAM (BC3 : awesomeface has alpha)
+		//Its mip chain stops early so that the levels never mix the two images
+		stbi_set_flip_vertically_on_load(true);
+		//Declared in the scope above like the shader : its ring is unmapped and deleted before glfwTerminate()
+		TextureStreamer textureStreamer;
+		//Its levels are copied from the mapping of the pack
+		unsigned int atlasTexture = textureStreamer.load(assets, "textures.ctex");
 
-	while (!glfwWindowShouldClose(window))
-	{
-		//Input
-		processInput(window);
+		shader.use();
+		//Both samplers read the atlas : one texture unit, one bind
+		shader.setInt("texture1", 0);
+		shader.setInt("texture2", 0);
 
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
 
-		//glBindTexture(GL_TEXTURE_2D, texture); //-> not necessary here
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture1);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
+		while (!glfwWindowShouldClose(window))
+		{
+			//Input
+			processInput(window);
+			textureStreamer.update();
+#ifndef EMBED_SHADERS
+			shaderWatcher.update();
+#endif
 
-		shader.use();
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT,0);
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			//glBindTexture(GL_TEXTURE_2D, texture); //-> not necessary here
+			//After the first frame these are all dropped by the cache
+			state.bindTexture(0, GL_TEXTURE_2D, atlasTexture);
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+			shader.use();
+			state.bindVertexArray(VAO);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT,0);
 
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+			//Issued/skipped bind counts of this frame, also added to state.getTotal()
+			state.endFrame();
+
+		}
+		//What the cache saved over the run : a skipped count near 0 means the binds are already minimal
+		const GLStateCache::Stats &binds = state.getTotal();
+		std::cout << "Binds : " << binds.issued << " issued, " << binds.skipped << " skipped over " << binds.frames << " frames";
+		if (binds.frames > 0)
+			std::cout << " (" << (double)binds.issued / binds.frames << " / " << (double)binds.skipped / binds.frames << " per frame)";
+		std::cout << std::endl;
+
+		state.forgetVertexArray(VAO);
+		state.forgetBuffer(VBO);
+		state.forgetBuffer(EBO);
+		state.forgetTexture(atlasTexture);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		glDeleteTextures(1, &atlasTexture);
 	}
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
 	glfwTerminate();
 	;	return 0;
 	}
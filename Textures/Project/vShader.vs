@@ -2,13 +2,25 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aCol;
 layout(location = 2) in vec2 aTexCoord;
+//Same corner in the atlas rectangle of the second image
+layout(location = 3) in vec2 aTexCoord2;
+#ifdef TEXTURE_ARRAY
+//Layers of the two materials in the texture array, per vertex or per instance (glVertexAttribDivisor)
+layout(location = 4) in vec2 aLayers;
+flat out vec2 Layers;
+#endif
 
 out vec3 vertex_color;
 out vec2 TexCoord;
+out vec2 TexCoord2;
 
 void main()
 {
 	gl_Position = vec4(aPos, 1.0);
 	vertex_color = aCol;
 	TexCoord = vec2(aTexCoord.x,aTexCoord.y);
+	TexCoord2 = aTexCoord2;
+#ifdef TEXTURE_ARRAY
+	Layers = aLayers;
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,609 @@
+#include "../Project/AssetPack.h"
+#include "../Project/BlockCompressor.h"
+#include "../Project/CookedTexture.h"
+#include "../Project/ImageArena.h"
+#include "../Project/MeshImporter.h"
+#include "../Project/MeshOptimizer.h"
+#include "../Project/MipGenerator.h"
+#include "../Project/TextureAtlas.h"
+#include "../Project/ThreadPool.h"
+#define STBI_MALLOC(size) ImageArena::allocate(size)
+#define STBI_REALLOC(pointer, size) ImageArena::reallocate(pointer, size)
+#define STBI_FREE(pointer) ImageArena::release(pointer)
+#define STB_IMAGE_IMPLEMENTATION
+#include "../Project/stb_image.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Offline side of CookedTexture : decodes the source images once and writes every mip level
+//in the format the GL wants, so that the samples never call stbi_load nor glGenerateMipmap for them
+//
+//Usage : TextureCooker [-flip] [-nomips] [-kaiser] [-linear] [-bc|-bc1|-bc3|-bc7] [-fast] [-atlas file.ctex] [-padding n] [-force] [-benchmark] image...
+//        TextureCooker -pack file.pack [-force] asset...
+//        TextureCooker -meshbench [mesh...]
+//	-flip       flip vertically, like stbi_set_flip_vertically_on_load(true)
+//	-nomips     only level 0
+//	-kaiser     Kaiser filter instead of the 2x2 box for the mip levels
+//	-linear     the color channels are not sRGB, filter them as they are
+//	-bc         block compress : BC1 for the opaque images, BC3 for the ones with alpha
+//	-bc1/3/7    block compress every image to that format
+//	-fast       fast block compression preset instead of the quality one
+//	-atlas      pack every image into file.ctex, the lookup table of their rectangles goes to file.atlas
+//	            only the mips that stay inside the gutters are kept
+//	-padding    texels of gutter around each image of the atlas, 8 by default
+//	-force      cook even when the .ctex is newer than the image
+//	-benchmark  time the mip generation of every SIMD kernel against the scalar one,
+//	            and the decoding on every core with malloc against the ImageArena, nothing is written
+//	-pack       copy the assets as they are (already cooked .ctex, shaders, .atlas tables) into one AssetPack file
+//	-meshbench  ACMR / ATVR before and after each pass of the MeshOptimizer, of the meshes given
+//	            or of large synthetic ones, nothing is written
+//Each image.ext gives image.ctex next to it, each mesh.obj / mesh.glb gives mesh.cmesh
+//(imported, optimized, then read by CookedMesh)
+
+bool formatOf(int channels, CookedTextureHeader &header)
+{
+	header.type = GL_UNSIGNED_BYTE;
+	switch (channels)
+	{
+	case 1: header.internalFormat = GL_R8; header.format = GL_RED; return true;
+	case 2: header.internalFormat = GL_RG8; header.format = GL_RG; return true;
+	case 3: header.internalFormat = GL_RGB8; header.format = GL_RGB; return true;
+	case 4: header.internalFormat = GL_RGBA8; header.format = GL_RGBA; return true;
+	default: return false;
+	}
+}
+
+//Settings given on the command line, the same for every image
+struct CookOptions
+{
+	bool mipmaps = true;
+	MipOptions mip;
+	//-bc : the format depends on the alpha of each image
+	bool compress = false;
+	bool autoFormat = true;
+	BlockFormat blockFormat = BlockFormat::BC1;
+	BlockPreset blockPreset = BlockPreset::Quality;
+};
+
+bool hasAlpha(const unsigned char* pixels, int width, int height, int channels)
+{
+	if (channels != 2 && channels != 4)
+		return false;
+	const std::size_t count = (std::size_t)width * height;
+	for (std::size_t i = 0; i < count; ++i)
+		if (pixels[i * channels + channels - 1] != 255)
+			return true;
+	return false;
+}
+
+bool writeCooked(const std::string &path, const CookedTextureHeader &header, const std::vector<MipLevel> &levels)
+{
+	std::vector<CookedTextureLevel> index(levels.size());
+	std::uint64_t offset = sizeof(header) + index.size() * sizeof(CookedTextureLevel);
+	for (std::size_t i = 0; i < levels.size(); ++i)
+	{
+		offset = (offset + COOKED_TEXTURE_ALIGNMENT - 1) & ~(std::uint64_t)(COOKED_TEXTURE_ALIGNMENT - 1);
+		index[i].offset = offset;
+		index[i].size = levels[i].pixels.size();
+		offset += index[i].size;
+	}
+
+	//Written next to the output then renamed, a running sample never maps half a file
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)index.data(), index.size() * sizeof(CookedTextureLevel));
+		std::uint64_t position = sizeof(header) + index.size() * sizeof(CookedTextureLevel);
+		const char padding[COOKED_TEXTURE_ALIGNMENT] = {};
+		for (std::size_t i = 0; i < levels.size(); ++i)
+		{
+			file.write(padding, index[i].offset - position);
+			file.write((const char*)levels[i].pixels.data(), levels[i].pixels.size());
+			position = index[i].offset + index[i].size;
+		}
+		if (!file)
+			return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+//maxLevels : the chain stops there even when the image is bigger than 1x1
+bool cookPixels(const unsigned char* pixels, int width, int height, int channels, const std::string &output, const CookOptions &options, ThreadPool &pool, int maxLevels)
+{
+	CookedTextureHeader header = {};
+	std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, 4);
+	header.version = COOKED_TEXTURE_VERSION;
+	header.width = width;
+	header.height = height;
+	if (!formatOf(channels, header))
+	{
+		std::cout << "ERROR::COOKER::UNSUPPORTED_CHANNELS " << output << std::endl;
+		return false;
+	}
+
+	std::vector<MipLevel> levels(1);
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(pixels, pixels + (std::size_t)width * height * channels);
+	if (options.mipmaps)
+	{
+		std::vector<MipLevel> chain = buildMipChain(pixels, width, height, channels, options.mip);
+		if ((int)chain.size() > maxLevels - 1)
+			chain.resize(maxLevels - 1);
+		levels.insert(levels.end(), std::make_move_iterator(chain.begin()), std::make_move_iterator(chain.end()));
+	}
+	BlockFormat blockFormat = options.blockFormat;
+	if (options.compress && options.autoFormat)
+		blockFormat = hasAlpha(pixels, width, height, channels) ? BlockFormat::BC3 : BlockFormat::BC1;
+	header.levelCount = (std::uint32_t)levels.size();
+
+	if (options.compress)
+	{
+		//The mips are filtered from the uncompressed levels, then each level is compressed on its own
+		header.internalFormat = blockFormatGL(blockFormat);
+		header.format = 0;
+		header.type = 0;
+		for (MipLevel &level : levels)
+			level.pixels = compressBlocks(level.pixels.data(), level.width, level.height, channels, blockFormat, options.blockPreset, &pool);
+	}
+
+	if (!writeCooked(output, header, levels))
+	{
+		std::cout << "ERROR::COOKER::WRITE_FAILED " << output << std::endl;
+		return false;
+	}
+	std::cout << output << " (" << width << "x" << height << ", " << levels.size() << " levels";
+	if (options.compress)
+		std::cout << (blockFormat == BlockFormat::BC1 ? ", BC1" : blockFormat == BlockFormat::BC3 ? ", BC3" : ", BC7");
+	std::cout << ")" << std::endl;
+	return true;
+}
+
+bool cook(const std::string &input, const std::string &output, const CookOptions &options, ThreadPool &pool)
+{
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 0);
+	if (!pixels)
+	{
+		std::cout << "ERROR::COOKER::LOAD_FAILED " << input << " " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	std::cout << input << " -> ";
+	const bool cooked = cookPixels(pixels, width, height, channels, output, options, pool, INT_MAX);
+	stbi_image_free(pixels);
+	return cooked;
+}
+
+//The images are found in the table by their file name
+bool cookAtlas(const std::vector<std::string> &inputs, const std::string &output, int padding, const CookOptions &options, ThreadPool &pool)
+{
+	TextureAtlas atlas(padding);
+	for (const std::string &input : inputs)
+	{
+		int width, height, channels;
+		unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 0);
+		if (!pixels)
+		{
+			std::cout << "ERROR::COOKER::LOAD_FAILED " << input << " " << stbi_failure_reason() << std::endl;
+			return false;
+		}
+		atlas.add(std::filesystem::path(input).filename().string(), pixels, width, height, channels);
+		stbi_image_free(pixels);
+	}
+	if (!atlas.build())
+		return false;
+
+	const std::string tablePath = std::filesystem::path(output).replace_extension(".atlas").string();
+	if (!atlas.getTable().save(tablePath))
+	{
+		std::cout << "ERROR::COOKER::WRITE_FAILED " << tablePath << std::endl;
+		return false;
+	}
+	std::cout << inputs.size() << " images -> " << tablePath << ", ";
+	return cookPixels(atlas.getPixels().data(), atlas.getWidth(), atlas.getHeight(), atlas.getChannels(), output, options, pool, atlas.getSafeLevelCount(options.compress, options.mip.filter));
+}
+
+AssetFormat assetFormatOf(const std::string &path)
+{
+	const std::string extension = std::filesystem::path(path).extension().string();
+	if (extension == ".ctex")
+		return AssetFormat::CookedTexture;
+	if (extension == ".vs" || extension == ".fs" || extension == ".glsl")
+		return AssetFormat::Shader;
+	return AssetFormat::Raw;
+}
+
+//The assets are found in the pack by the path given on the command line
+bool writePack(const std::vector<std::string> &inputs, const std::string &output)
+{
+	std::vector<std::string> payloads;
+	std::vector<AssetPackEntry> entries;
+	std::string names;
+	for (const std::string &input : inputs)
+	{
+		std::ifstream file(input, std::ios::binary);
+		if (!file)
+		{
+			std::cout << "ERROR::COOKER::LOAD_FAILED " << input << std::endl;
+			return false;
+		}
+		payloads.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		const std::string name = std::filesystem::path(input).generic_string();
+		AssetPackEntry entry = {};
+		entry.nameHash = Shader::hashSource(name);
+		entry.contentHash = Shader::hashSource(payloads.back());
+		entry.size = payloads.back().size();
+		entry.format = (std::uint32_t)assetFormatOf(input);
+		entry.nameOffset = (std::uint32_t)names.size();
+		for (const AssetPackEntry &other : entries)
+			if (other.nameHash == entry.nameHash)
+			{
+				std::cout << "ERROR::COOKER::DUPLICATE_ASSET " << name << std::endl;
+				return false;
+			}
+		names += name;
+		names += '\0';
+		entries.push_back(entry);
+	}
+
+	AssetPackHeader header = {};
+	std::memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = (std::uint32_t)entries.size();
+	header.slotCount = 1;
+	while (header.slotCount < header.entryCount * 2)
+		header.slotCount *= 2;
+	std::vector<std::uint32_t> slots(header.slotCount, ASSET_PACK_EMPTY_SLOT);
+	for (std::uint32_t i = 0; i < header.entryCount; ++i)
+	{
+		std::uint32_t slot = (std::uint32_t)entries[i].nameHash & (header.slotCount - 1);
+		while (slots[slot] != ASSET_PACK_EMPTY_SLOT)
+			slot = (slot + 1) & (header.slotCount - 1);
+		slots[slot] = i;
+	}
+	header.namesOffset = sizeof(header) + entries.size() * sizeof(AssetPackEntry) + slots.size() * sizeof(std::uint32_t);
+	header.namesSize = names.size();
+	std::uint64_t offset = header.namesOffset + header.namesSize;
+	for (AssetPackEntry &entry : entries)
+	{
+		offset = (offset + ASSET_PACK_ALIGNMENT - 1) & ~(std::uint64_t)(ASSET_PACK_ALIGNMENT - 1);
+		entry.offset = offset;
+		offset += entry.size;
+	}
+
+	//Same as writeCooked : a running sample never maps half a file
+	const std::string temporary = output + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(), entries.size() * sizeof(AssetPackEntry));
+		file.write((const char*)slots.data(), slots.size() * sizeof(std::uint32_t));
+		file.write(names.data(), names.size());
+		std::uint64_t position = header.namesOffset + header.namesSize;
+		const char padding[ASSET_PACK_ALIGNMENT] = {};
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			file.write(padding, entries[i].offset - position);
+			file.write(payloads[i].data(), payloads[i].size());
+			position = entries[i].offset + entries[i].size;
+		}
+		if (!file)
+			return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, output, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+bool isUpToDate(const std::string &input, const std::string &output)
+{
+	std::error_code error;
+	const auto outputTime = std::filesystem::last_write_time(output, error);
+	if (error)
+		return false;
+	const auto inputTime = std::filesystem::last_write_time(input, error);
+	return !error && outputTime >= inputTime;
+}
+
+//Every core decodes the image again and again, a few at a time, then frees them and ends the batch like a decode job
+//of the streamer
+void benchmarkDecode(const std::string &input, int iterations, std::ostream &out)
+{
+	std::ifstream file(input, std::ios::binary);
+	const std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	const int batch = 4;
+	out << "Decoding on " << threadCount << " threads, " << batch << " images per batch" << std::endl;
+
+	double systemTime = 0.0;
+	for (bool arena : { false, true })
+	{
+		ImageArena::setEnabled(arena);
+		ImageArena::resetStats();
+		std::atomic<std::size_t> decodedBytes{ 0 };
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threadCount; ++t)
+			threads.emplace_back([&]
+			{
+				for (int i = 0; i < iterations; i += batch)
+				{
+					unsigned char* images[batch] = {};
+					for (int j = 0; j < batch && i + j < iterations; ++j)
+					{
+						int width, height, channels;
+						images[j] = stbi_load_from_memory(encoded.data(), (int)encoded.size(), &width, &height, &channels, 0);
+						if (images[j])
+							decodedBytes += (std::size_t)width * height * channels;
+					}
+					for (unsigned char* image : images)
+						stbi_image_free(image);
+					ImageArena::endBatch();
+				}
+			});
+		for (std::thread &thread : threads)
+			thread.join();
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!arena)
+			systemTime = time;
+
+		out << "\t" << (arena ? "arena" : "malloc") << "\t" << time / (iterations * threadCount) << " ms per image\t"
+			<< decodedBytes / (time * 1000.0) << " MB/s\tx" << systemTime / time;
+		if (arena)
+		{
+			const ImageArena::Stats stats = ImageArena::getStats();
+			out << "\tpeak " << (stats.peakBytes >> 10) << " KB, reserved " << (stats.reservedBytes >> 10) << " KB, " << stats.rewinds << " rewinds";
+		}
+		out << std::endl;
+	}
+	ImageArena::setEnabled(true);
+}
+
+//Synthetic meshes of -meshbench, counter clockwise seen from outside
+void makeGrid(int size, std::vector<unsigned int> &indices, std::vector<float> &positions)
+{
+	for (int y = 0; y <= size; ++y)
+		for (int x = 0; x <= size; ++x)
+			positions.insert(positions.end(), { (float)x / size, (float)y / size, 0.0f });
+	for (int y = 0; y < size; ++y)
+		for (int x = 0; x < size; ++x)
+		{
+			const unsigned int corner = y * (size + 1) + x;
+			indices.insert(indices.end(), { corner, corner + 1, corner + size + 2, corner, corner + size + 2, corner + size + 1 });
+		}
+}
+
+void makeSphere(int rings, int segments, std::vector<unsigned int> &indices, std::vector<float> &positions)
+{
+	const double pi = 3.14159265358979323846;
+	for (int ring = 0; ring <= rings; ++ring)
+		for (int segment = 0; segment <= segments; ++segment)
+		{
+			const double theta = pi * ring / rings, phi = 2.0 * pi * segment / segments;
+			positions.insert(positions.end(), { (float)(std::sin(theta) * std::cos(phi)), (float)(std::sin(theta) * std::sin(phi)), (float)std::cos(theta) });
+		}
+	for (int ring = 0; ring < rings; ++ring)
+		for (int segment = 0; segment < segments; ++segment)
+		{
+			const unsigned int corner = ring * (segments + 1) + segment;
+			indices.insert(indices.end(), { corner, corner + segments + 1, corner + 1, corner + 1, corner + segments + 1, corner + segments + 2 });
+		}
+}
+
+//Triangles and vertices in a random order, like an exporter that does not care
+void shuffleMesh(std::vector<unsigned int> &indices, std::vector<float> &positions)
+{
+	std::mt19937 random(42);
+	std::vector<unsigned int> triangles(indices.size() / 3);
+	for (std::size_t t = 0; t < triangles.size(); ++t)
+		triangles[t] = (unsigned int)t;
+	std::shuffle(triangles.begin(), triangles.end(), random);
+	std::vector<unsigned int> remap(positions.size() / 3);
+	for (std::size_t v = 0; v < remap.size(); ++v)
+		remap[v] = (unsigned int)v;
+	std::shuffle(remap.begin(), remap.end(), random);
+
+	std::vector<unsigned int> shuffledIndices;
+	shuffledIndices.reserve(indices.size());
+	for (unsigned int t : triangles)
+		for (int corner = 0; corner < 3; ++corner)
+			shuffledIndices.push_back(remap[indices[t * 3 + corner]]);
+	std::vector<float> shuffledPositions(positions.size());
+	for (std::size_t v = 0; v < remap.size(); ++v)
+		std::copy(positions.begin() + v * 3, positions.begin() + v * 3 + 3, shuffledPositions.begin() + remap[v] * 3);
+	indices.swap(shuffledIndices);
+	positions.swap(shuffledPositions);
+}
+
+//Returns the number of meshes that could not be read
+int benchmarkMeshes(const std::vector<std::string> &inputs, ThreadPool &pool, std::ostream &out)
+{
+	if (!inputs.empty())
+	{
+		int failures = 0;
+		for (const std::string &input : inputs)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			ImportedMesh mesh;
+			if (!importMesh(input, mesh, &pool))
+			{
+				++failures;
+				continue;
+			}
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			out << input << " : imported in " << elapsed.count() << " ms on " << pool.getWorkerCount() << " workers" << std::endl;
+			std::vector<float> positions(mesh.vertices.size() * 3);
+			for (std::size_t v = 0; v < mesh.vertices.size(); ++v)
+				std::memcpy(&positions[v * 3], mesh.vertices[v].position.v, 3 * sizeof(float));
+			benchmarkMeshOptimizer(input.c_str(), std::vector<unsigned int>(mesh.indices.begin(), mesh.indices.end()), positions, out);
+		}
+		return failures;
+	}
+
+	std::vector<unsigned int> indices;
+	std::vector<float> positions;
+	makeGrid(512, indices, positions);
+	benchmarkMeshOptimizer("grid 512x512, rows", indices, positions, out);
+	shuffleMesh(indices, positions);
+	benchmarkMeshOptimizer("grid 512x512, shuffled", indices, positions, out);
+
+	indices.clear();
+	positions.clear();
+	makeSphere(400, 800, indices, positions);
+	shuffleMesh(indices, positions);
+	benchmarkMeshOptimizer("sphere 400x800, shuffled", indices, positions, out);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool flip = false;
+	bool force = false;
+	bool benchmark = false;
+	bool meshBenchmark = false;
+	std::string atlasPath;
+	std::string packPath;
+	int padding = 8;
+	CookOptions options;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-flip") == 0)
+			flip = true;
+		else if (std::strcmp(argv[i], "-nomips") == 0)
+			options.mipmaps = false;
+		else if (std::strcmp(argv[i], "-kaiser") == 0)
+			options.mip.filter = MipFilter::Kaiser;
+		else if (std::strcmp(argv[i], "-linear") == 0)
+			options.mip.srgb = false;
+		else if (std::strcmp(argv[i], "-bc") == 0)
+			options.compress = true;
+		else if (std::strcmp(argv[i], "-bc1") == 0 || std::strcmp(argv[i], "-bc3") == 0 || std::strcmp(argv[i], "-bc7") == 0)
+		{
+			options.compress = true;
+			options.autoFormat = false;
+			options.blockFormat = argv[i][3] == '1' ? BlockFormat::BC1 : argv[i][3] == '3' ? BlockFormat::BC3 : BlockFormat::BC7;
+		}
+		else if (std::strcmp(argv[i], "-fast") == 0)
+			options.blockPreset = BlockPreset::Fast;
+		else if (std::strcmp(argv[i], "-atlas") == 0 && i + 1 < argc)
+			atlasPath = argv[++i];
+		else if (std::strcmp(argv[i], "-pack") == 0 && i + 1 < argc)
+			packPath = argv[++i];
+		else if (std::strcmp(argv[i], "-padding") == 0 && i + 1 < argc)
+			padding = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-force") == 0)
+			force = true;
+		else if (std::strcmp(argv[i], "-benchmark") == 0)
+			benchmark = true;
+		else if (std::strcmp(argv[i], "-meshbench") == 0)
+			meshBenchmark = true;
+		else
+			inputs.push_back(argv[i]);
+	}
+	if (meshBenchmark)
+	{
+		ThreadPool pool(std::thread::hardware_concurrency());
+		return benchmarkMeshes(inputs, pool, std::cout) == 0 ? 0 : 1;
+	}
+	if (inputs.empty())
+	{
+		std::cout << "Usage : TextureCooker [-flip] [-nomips] [-kaiser] [-linear] [-bc|-bc1|-bc3|-bc7] [-fast] [-atlas file.ctex] [-padding n] [-force] [-benchmark] image..." << std::endl;
+		std::cout << "        TextureCooker -pack file.pack [-force] asset..." << std::endl;
+		std::cout << "        TextureCooker -meshbench [mesh...]" << std::endl;
+		return 1;
+	}
+
+	if (!packPath.empty())
+	{
+		bool upToDate = !force;
+		for (const std::string &input : inputs)
+			upToDate = upToDate && isUpToDate(input, packPath);
+		if (upToDate)
+			return 0;
+		return writePack(inputs, packPath) ? 0 : 1;
+	}
+
+	stbi_set_flip_vertically_on_load(flip);
+	int failures = 0;
+	if (benchmark)
+	{
+		for (const std::string &input : inputs)
+		{
+			int width, height, channels;
+			unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 0);
+			if (!pixels)
+			{
+				std::cout << "ERROR::COOKER::LOAD_FAILED " << input << " " << stbi_failure_reason() << std::endl;
+				++failures;
+				continue;
+			}
+			std::cout << input << std::endl;
+			benchmarkMipChain(pixels, width, height, channels, MipFilter::Box, 20, std::cout);
+			benchmarkMipChain(pixels, width, height, channels, MipFilter::Kaiser, 10, std::cout);
+			stbi_image_free(pixels);
+			benchmarkDecode(input, 40, std::cout);
+		}
+		return failures == 0 ? 0 : 1;
+	}
+	//Used by the block compression, the blocks of a level are shared out between the workers,
+	//and by the mesh import, the slices of the file
+	ThreadPool pool(std::thread::hardware_concurrency());
+	if (!atlasPath.empty())
+	{
+		bool upToDate = !force;
+		for (const std::string &input : inputs)
+			upToDate = upToDate && isUpToDate(input, atlasPath);
+		if (upToDate)
+			return 0;
+		return cookAtlas(inputs, atlasPath, padding, options, pool) ? 0 : 1;
+	}
+	for (const std::string &input : inputs)
+	{
+		if (isMeshPath(input))
+		{
+			const std::string output = std::filesystem::path(input).replace_extension(".cmesh").string();
+			if (!force && isUpToDate(input, output))
+				continue;
+			if (!cookMesh(input, output, &pool))
+				++failures;
+			continue;
+		}
+		const std::string output = std::filesystem::path(input).replace_extension(".ctex").string();
+		if (!force && isUpToDate(input, output))
+			continue;
+		if (!cook(input, output, options, pool))
+			++failures;
+	}
+	return failures == 0 ? 0 : 1;
+}